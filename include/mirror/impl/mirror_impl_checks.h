@@ -41,8 +41,9 @@ extern "C" {
  * Checks that the given expression is true.
  */
 
-/* TODO pass a message, stringify the arg */
-#define mirror_check(x) ghost_ensure(x, "mirror check failed") /* TODO consider calling this mirror_true() */
+/* TODO pass a message */
+#define mirror_check(x) ((x) ? (void)0 : mirror_handle_failure(__FILE__, __LINE__, \
+            "Check failed!\n    " #x "\n")) /* TODO consider calling this mirror_true() */
 
 /**
  * @def mirror_eq(x, y) if (x != y) fail()
@@ -54,7 +55,7 @@ extern "C" {
 
 /* TODO GHOST_INSERT_COMMA isn't working
  *#define mirror_error(...) ghost_ensure(0 GHOST_INSERT_COMMA(__VA_ARGS__)) */
-#define mirror_error() ghost_ensure(0, "mirror check failed")
+#define mirror_error() mirror_handle_failure(__FILE__, __LINE__, "mirror_error() called.\n")
 
 /* TODO */
 #define mirror_eq(x, y) mirror_check((x) == (y))
@@ -70,11 +71,13 @@ extern "C" {
 
 
 
-ghost_maybe_unused
-static void mirror_handle_failure(const char* file, int line, const char* message) {
-    printf("%s:%i %s", file, line, message);
-    ghost_fatal("");
-}
+/*
+ * Reports a failed check. This is implemented by the runner.
+ *
+ * This doesn't return. The internal runner unwinds the current test and moves
+ * on to the next one (or stops the run with --fail-fast.)
+ */
+void mirror_handle_failure(const char* file, int line, const char* message);
 
 
 typedef enum mirror_op_t {
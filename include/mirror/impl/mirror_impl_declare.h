@@ -27,6 +27,7 @@
 
 #include "mirror/impl/mirror_impl_ghost.h"
 #include "mirror/impl/mirror_impl_iwbt.h"
+#include "mirror/impl/mirror_impl_strkey.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -61,6 +62,8 @@ extern "C" {
 
 /**
  * A test suite.
+ *
+ * A suite has a fixture that is shared by the tests in it. See mirror_suite().
  */
 typedef struct mirror_suite_t mirror_suite_t;
 
@@ -83,6 +86,168 @@ typedef void (*mirror_thunk_t)(void* fixture, void* param);
  */
 /*typedef void (*mirror_suite_thunk_t)(mirror_suite_t* test_suite); */
 
+/*
+ * The result of running a test.
+ */
+typedef enum mirror_status_t {
+    mirror_status_none,  /* not run (yet) */
+    mirror_status_pass,
+    mirror_status_fail,  /* a check failed */
+    mirror_status_crash, /* the test died without a failing check */
+    mirror_status_timeout,
+    mirror_status_skip,   /* skipped with the skip option */
+    mirror_status_blocked /* a test it depends on didn't pass */
+} mirror_status_t;
+
+/**
+ * A source of parameters for a test with a param() option, given with the
+ * params() option:
+ *
+ *     static const int primes[] = {2, 3, 5, 7, 11};
+ *
+ *     mirror(param(int, p), params(mirror_params_array(primes))) {
+ *         mirror_check(p > 1);
+ *     }
+ *
+ *     mirror(param(long, n), params(mirror_params_range(0, 1000000))) {
+ *         mirror_check(n >= 0);
+ *     }
+ *
+ * Each parameter is made just before the instance of the test that takes it
+ * runs so they're never all in memory at once. The runner shares instances out
+ * to workers in chunks. A parameterized test stops at the first instance
+ * that doesn't pass.
+ */
+typedef struct mirror_params_t mirror_params_t;
+
+struct mirror_params_t {
+    ghost_uint64_t count;
+
+    /* makes the parameter of the instance at the given index */
+    void (*make)(const mirror_params_t* params, void* param,
+            ghost_size_t param_size, ghost_uint64_t index);
+
+    const void* array;
+    ghost_size_t element_size;
+    ghost_int64_t first; /* of a range */
+    void (*generate)(void* param, ghost_uint64_t index, void* context);
+    void* context;
+};
+
+/**
+ * Parameters copied from an array whose elements have the type of the
+ * param().
+ */
+mirror_params_t mirror_params_of(const void* array, ghost_size_t element_size, ghost_uint64_t count);
+
+#define mirror_params_array(array) \
+    mirror_params_of((array), sizeof(*(array)), sizeof(array) / sizeof(*(array)))
+
+/**
+ * The integers from first up to but not including end. The param() must be
+ * an integer type.
+ */
+mirror_params_t mirror_params_range(ghost_int64_t first, ghost_int64_t end);
+
+/**
+ * Parameters made by calling the given function with the index of each
+ * instance. It must fill in the param() it's given and must be safe to call
+ * from any worker thread at the same time.
+ */
+mirror_params_t mirror_params_generate(ghost_uint64_t count,
+        void (*generate)(void* param, ghost_uint64_t index, void* context), void* context);
+
+/**
+ * A record of a corpus, the param of a test with the corpus() option:
+ *
+ *     mirror(param(mirror_record_t, golden), corpus("test/golden")) {
+ *         mirror_check(golden.size > 0);
+ *     }
+ *
+ * A corpus is a file, which is a single record, or a directory whose regular
+ * files are its records in order of their names. Paths are relative to the
+ * working directory of the runner.
+ *
+ * Each corpus is mapped into memory once per process before any tests run and
+ * records point straight into the mapping. Worker processes share it. The
+ * data is read-only.
+ */
+typedef struct mirror_record_t {
+    const char* name; /* the path of its file */
+    const void* data;
+    ghost_size_t size;
+} mirror_record_t;
+
+/**
+ * Pseudorandom numbers for property tests. Each case of a property gets its
+ * own, seeded from the run's seed (see --seed) and the index of the case, so
+ * a case makes the same input on whichever worker runs it.
+ */
+typedef struct mirror_random_t {
+    ghost_uint64_t state;
+} mirror_random_t;
+
+/** Returns the next 64 random bits. */
+ghost_uint64_t mirror_random_next(mirror_random_t* random);
+
+/** Returns a random number below the given bound, which must not be 0. */
+ghost_uint64_t mirror_random_below(mirror_random_t* random, ghost_uint64_t bound);
+
+/**
+ * A generator of random inputs for a test with a param() option, given with
+ * the property() option:
+ *
+ *     mirror(param(int, x), property(mirror_property_integers(1000000, -100, 100))) {
+ *         mirror_check(x * x >= 0);
+ *     }
+ *
+ * The test runs with count generated inputs, shared out to workers like
+ * params(). If one fails the runner shrinks it: it keeps whichever smaller
+ * candidates still fail until there are none left to try, then runs the
+ * test once more with the smallest to report it.
+ */
+typedef struct mirror_property_t mirror_property_t;
+
+struct mirror_property_t {
+    ghost_uint64_t count; /* cases to run, or 0 for MIRROR_PROPERTY_CASES */
+
+    /* makes the param of a case */
+    void (*generate)(const mirror_property_t* property, void* param,
+            ghost_size_t param_size, mirror_random_t* random);
+
+    /* makes the given attempt at a smaller candidate for a failing param,
+     * returning false if there are no more attempts to make (nullable) */
+    ghost_bool (*shrink)(const mirror_property_t* property, void* candidate,
+            const void* param, ghost_size_t param_size, ghost_uint64_t attempt);
+
+    /* prints a param in a report (nullable) */
+    void (*print)(const mirror_property_t* property, const void* param, ghost_size_t param_size);
+
+    ghost_int64_t min; /* of integers */
+    ghost_int64_t max;
+    void* context;
+};
+
+/**
+ * Integers from min to max inclusive, with the bounds and zero more likely
+ * than the rest. They shrink towards zero. The param() must be an integer
+ * type.
+ */
+mirror_property_t mirror_property_integers(ghost_uint64_t count, ghost_int64_t min, ghost_int64_t max);
+
+/**
+ * A property with the given functions. The shrink and print functions may be
+ * null. They must all be safe to call from any worker thread at the same
+ * time.
+ */
+mirror_property_t mirror_property_generate(ghost_uint64_t count,
+        void (*generate)(const mirror_property_t* property, void* param,
+            ghost_size_t param_size, mirror_random_t* random),
+        ghost_bool (*shrink)(const mirror_property_t* property, void* candidate,
+            const void* param, ghost_size_t param_size, ghost_uint64_t attempt),
+        void (*print)(const mirror_property_t* property, const void* param, ghost_size_t param_size),
+        void* context);
+
 struct mirror_suite_t {
 
     /* options */
@@ -102,10 +267,13 @@ struct mirror_suite_t {
     ghost_size_t fixture_size;
     void (*fixture_setup)(void*);
     void (*fixture_teardown)(void*);
+    const char* file;
+    int line;
 
     /* links */
     mirror_iwbt_node_t all_suites;
     mirror_iwbt_node_t suite_suites;
+    ghost_size_t index; /* of its shared fixture in each worker, set by the runner */
     /*
     mirror_suite_t* parent;
     mirror_test_t* first_test;
@@ -123,6 +291,7 @@ struct mirror_test_t {
     /* options */
     const char* id;
     const char* name;
+    ghost_bool named; /* by the name() option rather than MIRROR_NAME */
     mirror_thunk_t fn;
     ghost_bool death;
     ghost_bool smoke;
@@ -132,6 +301,12 @@ struct mirror_test_t {
     const char* description;
     const char** deps;
     size_t deps_count;
+    unsigned long timeout; /* milliseconds, or 0 for the runner's default */
+    const char* suite_name; /* or null if it's not in a suite */
+    ghost_size_t param_size; /* or 0 if it doesn't take a param */
+    mirror_params_t params;
+    mirror_property_t property;
+    const char* corpus; /* path of its records, or null */
 
     ghost_size_t fixture_size;
     void (*fixture_setup)(void*);
@@ -141,10 +316,39 @@ struct mirror_test_t {
     mirror_suite_t* suite;
     mirror_iwbt_node_t all_tests;
     mirror_iwbt_node_t suite_tests;
+    mirror_strkey_t name_key; /* key of both trees, next to their nodes */
+
+    /* registry of the current run, built by the runner */
+    ghost_uint32_t handle; /* index in the registry */
+    ghost_uint32_t name_id; /* interned name; equal names have equal ids */
+    ghost_uint32_t file_id; /* interned file */
+    ghost_uint64_t key; /* hash of file and name or id, for the history and sharding */
+
+    /* results */
+    mirror_status_t status;
+    ghost_uint64_t duration; /* wall time in nanoseconds */
+    ghost_uint64_t cpu_user; /* CPU time in nanoseconds, if measured */
+    ghost_uint64_t cpu_system;
+    ghost_uint64_t expected; /* duration of the previous run, or 0 if unknown */
+    mirror_status_t previous; /* status of the previous run, or none if unknown */
+    ghost_bool changed; /* new or changed since the previous run */
+    ghost_uint64_t fingerprint; /* of the test's source, for the history */
+
+    /* dependency graph of the current run, built by the runner */
+    ghost_bool planned;
+    ghost_size_t waiting; /* dependencies that haven't finished yet */
+    mirror_test_t** dependents;
+    ghost_size_t dependents_count;
+
+    /* instances of a parameterized test, shared out by the runner */
+    ghost_uint64_t params_next; /* the next instance to be claimed */
+    ghost_size_t params_entries; /* schedule entries that haven't finished */
 };
 
 void mirror_register_test(mirror_test_t* test);
 
+void mirror_register_suite(mirror_suite_t* suite);
+
 
 
 /*
@@ -155,22 +359,69 @@ void mirror_register_test(mirror_test_t* test);
  * emulation of it. This makes the blocks run automatically.
  *
  * Some compilers like TinyCC don't support this so we use a workaround that
- * requires buildsystem support. The registration blocks in this case are
- * simply extern functions starting with mirror_REGISTER_. After compiling all
- * source files, a script runs through all object files looking for functions
- * that start with mirror_REGISTER_. It then generates a source file with a
- * function called mirror_register_all() which just calls all functions
- * starting with mirror_REGISTER_. Mirror then calls mirror_register_all() on
- * startup.
+ * requires buildsystem support (MIRROR_GENERATED_REGISTRY.) The registration
+ * blocks in this case are simply extern functions starting with
+ * mirror_REGISTER_, followed by the file's MIRROR_ID (which must be unique)
+ * if it has one. After compiling all source files, tools/mirror-registry runs
+ * through the object files looking for these functions and generates a source
+ * file with a table of them called mirror_registry. The runner walks the table
+ * on startup. See test/Makefile for an example.
+ *
+ * On ELF platforms with GCC or Clang we don't run anything at startup.
+ * Instead a pointer to each registration block is placed in the mirror_tests
+ * section. The linker gathers these into one array bounded by
+ * __start_mirror_tests and __stop_mirror_tests so the runner can register all
+ * tests at once and sort them by name in a single pass rather than inserting
+ * them into the test tree one by one. Define MIRROR_SECTION_REGISTRY to 0 to
+ * use static constructors instead, for example if tests are spread across
+ * shared libraries (each of which has its own section.)
  */
-#if ghost_has(ghost_static_init)
+#ifndef MIRROR_GENERATED_REGISTRY
+    #if ghost_has(ghost_static_init)
+        #define MIRROR_GENERATED_REGISTRY 0
+    #else
+        #define MIRROR_GENERATED_REGISTRY 1
+    #endif
+#endif
+
+#ifndef MIRROR_SECTION_REGISTRY
+    #if (GHOST_GCC || defined(__clang__)) && defined(__ELF__) && !MIRROR_GENERATED_REGISTRY
+        #define MIRROR_SECTION_REGISTRY 1
+    #else
+        #define MIRROR_SECTION_REGISTRY 0
+    #endif
+#endif
+
+/* A registration block, as found in the section or generated table */
+typedef void (*mirror_registration_t)(void);
+
+#if MIRROR_GENERATED_REGISTRY
+    #ifdef MIRROR_ID
+        #define MIRROR_IMPL_REGISTRATION_NAME(id) \
+                GHOST_CONCAT(GHOST_CONCAT(mirror_REGISTER_, MIRROR_ID), GHOST_CONCAT(_, id))
+    #else
+        #define MIRROR_IMPL_REGISTRATION_NAME(id) GHOST_CONCAT(mirror_REGISTER_, id)
+    #endif
+    #ifdef __cplusplus
+        #define MIRROR_IMPL_EXTERN_C extern "C"
+    #else
+        #define MIRROR_IMPL_EXTERN_C /*nothing*/
+    #endif
     #define MIRROR_REGISTRATION_BLOCK(id) \
-            ghost_static_init(GHOST_CONCAT(mirror_REGISTER_, id))
+            MIRROR_IMPL_EXTERN_C void MIRROR_IMPL_REGISTRATION_NAME(id)(void); \
+            MIRROR_IMPL_EXTERN_C void MIRROR_IMPL_REGISTRATION_NAME(id)(void)
+extern const mirror_registration_t mirror_registry[];
+extern const size_t mirror_registry_count;
+#elif MIRROR_SECTION_REGISTRY
+    #define MIRROR_REGISTRATION_BLOCK(id) \
+            static void GHOST_CONCAT(mirror_REGISTER_, id)(void); \
+            static void (*const GHOST_CONCAT(mirror_REGISTRY_, id))(void) \
+                    __attribute__((__used__, __section__("mirror_tests"))) = \
+                    GHOST_CONCAT(mirror_REGISTER_, id); \
+            static void GHOST_CONCAT(mirror_REGISTER_, id)(void)
 #else
     #define MIRROR_REGISTRATION_BLOCK(id) \
-            void GHOST_CONCAT(mirror_REGISTER_, id)(void); \
-            void GHOST_CONCAT(mirror_REGISTER_, id)(void)
-void mirror_register_all(void);
+            ghost_static_init(GHOST_CONCAT(mirror_REGISTER_, id))
 #endif
 
 
@@ -181,6 +432,21 @@ void mirror_register_all(void);
 
 
 
+/*
+ * MIRROR_IMPL_FAST_PP selects a faster expansion of mirror(...) for
+ * conforming C99 and C++11 preprocessors. See "Fast path" below.
+ */
+#ifndef MIRROR_IMPL_FAST_PP
+    #if GHOST_PP_VA_ARGS && !GHOST_MSVC_TRADITIONAL && !GHOST_CPARSER_PP && \
+            !defined(__PCC__) && !defined(__CPARSER__)
+        #define MIRROR_IMPL_FAST_PP 1
+    #else
+        #define MIRROR_IMPL_FAST_PP 0
+    #endif
+#endif
+
+
+
 /**
  * @def mirror(...)
  *
@@ -200,6 +466,11 @@ void mirror_register_all(void);
     #elif GHOST_MSVC_TRADITIONAL
         #define mirror(...) GHOST_EXPAND(GHOST_CONCAT(mirror_, GHOST_COUNT_ARGS(__VA_ARGS__))(__VA_ARGS__))
 
+    #elif MIRROR_IMPL_FAST_PP
+        #define mirror(...) MIRROR_IMPL_FAST_PICK(__VA_ARGS__, \
+                MIRROR_IMPL_FAST_8, MIRROR_IMPL_FAST_7, MIRROR_IMPL_FAST_6, MIRROR_IMPL_FAST_5, \
+                MIRROR_IMPL_FAST_4, MIRROR_IMPL_FAST_3, MIRROR_IMPL_FAST_2, MIRROR_IMPL_FAST_1, ~)(__VA_ARGS__)
+
     #else
         #define mirror(...) GHOST_CONCAT(mirror_, GHOST_COUNT_ARGS(__VA_ARGS__))(__VA_ARGS__)
     #endif
@@ -360,7 +631,9 @@ __pragma(warning(disable:4003))
 /* unprefixed */
 /* id */
 #define MIRROR_EXTRACT_mirror_id_ MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_corpus(path) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_death MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_deps(...) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_fixture(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_id(id) MIRROR_EXTRACT_MATCH /*MATCH*/
 #define MIRROR_EXTRACT_mirror_id_it(desc) MIRROR_EXTRACT_NOMATCH
@@ -368,14 +641,20 @@ __pragma(warning(disable:4003))
 #define MIRROR_EXTRACT_mirror_id_nothing MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_param(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_params(params) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_property(property) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_serial MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_setup(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_skip MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_smoke MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_suite(s) MIRROR_EXTRACT_NOMATCH /* TODO delete suite */
 #define MIRROR_EXTRACT_mirror_id_suffix(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_teardown(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_timeout(ms) MIRROR_EXTRACT_NOMATCH
 /* fixture */
 #define MIRROR_EXTRACT_mirror_fixture_ MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_corpus(path) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_death MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_deps(...) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_fixture(type, name) MIRROR_EXTRACT_MATCH /*MATCH*/
 #define MIRROR_EXTRACT_mirror_fixture_id(id) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_it(desc) MIRROR_EXTRACT_NOMATCH
@@ -383,14 +662,20 @@ __pragma(warning(disable:4003))
 #define MIRROR_EXTRACT_mirror_fixture_nothing MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_param(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_params(params) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_property(property) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_serial MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_setup(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_skip MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_smoke MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_suite(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_suffix(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_teardown(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_timeout(ms) MIRROR_EXTRACT_NOMATCH
 /* param */
 #define MIRROR_EXTRACT_mirror_param_ MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_corpus(path) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_death MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_deps(...) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_fixture(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_id(id) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_it(desc) MIRROR_EXTRACT_NOMATCH
@@ -398,16 +683,22 @@ __pragma(warning(disable:4003))
 #define MIRROR_EXTRACT_mirror_param_nothing MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_param(type, name) MIRROR_EXTRACT_MATCH /*MATCH*/
 #define MIRROR_EXTRACT_mirror_param_params(params) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_property(property) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_serial MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_setup(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_skip MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_smoke MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_suite(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_suffix(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_teardown(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_timeout(ms) MIRROR_EXTRACT_NOMATCH
 
 /* prefixed */
 /* id */
 #define MIRROR_EXTRACT_mirror_id_mirror_ MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_mirror_corpus(path) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_death MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_mirror_deps(...) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_fixture(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_id(id) MIRROR_EXTRACT_MATCH /*MATCH*/
 #define MIRROR_EXTRACT_mirror_id_mirror_it(desc) MIRROR_EXTRACT_NOMATCH
@@ -415,14 +706,20 @@ __pragma(warning(disable:4003))
 #define MIRROR_EXTRACT_mirror_id_mirror_nothing MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_param(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_params(params) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_mirror_property(property) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_serial MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_setup(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_mirror_skip MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_mirror_smoke MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_suite(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_suffix(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_id_mirror_teardown(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_id_mirror_timeout(ms) MIRROR_EXTRACT_NOMATCH
 /* fixture */
 #define MIRROR_EXTRACT_mirror_fixture_mirror_ MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_mirror_corpus(path) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_death MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_mirror_deps(...) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_fixture(type, name) MIRROR_EXTRACT_MATCH /*MATCH*/
 #define MIRROR_EXTRACT_mirror_fixture_mirror_id(id) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_it(desc) MIRROR_EXTRACT_NOMATCH
@@ -430,14 +727,20 @@ __pragma(warning(disable:4003))
 #define MIRROR_EXTRACT_mirror_fixture_mirror_nothing MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_param(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_params(params) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_mirror_property(property) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_serial MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_setup(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_mirror_skip MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_mirror_smoke MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_suite(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_suffix(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_fixture_mirror_teardown(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_fixture_mirror_timeout(ms) MIRROR_EXTRACT_NOMATCH
 /* param */
 #define MIRROR_EXTRACT_mirror_param_mirror_ MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_mirror_corpus(path) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_death MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_mirror_deps(...) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_fixture(type, name) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_id(id) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_it(desc) MIRROR_EXTRACT_NOMATCH
@@ -445,11 +748,15 @@ __pragma(warning(disable:4003))
 #define MIRROR_EXTRACT_mirror_param_mirror_nothing MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_param(type, name) MIRROR_EXTRACT_MATCH /*MATCH*/
 #define MIRROR_EXTRACT_mirror_param_mirror_params(params) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_mirror_property(property) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_serial MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_setup(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_mirror_skip MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_mirror_smoke MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_suite(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_suffix(s) MIRROR_EXTRACT_NOMATCH
 #define MIRROR_EXTRACT_mirror_param_mirror_teardown(fn) MIRROR_EXTRACT_NOMATCH
+#define MIRROR_EXTRACT_mirror_param_mirror_timeout(ms) MIRROR_EXTRACT_NOMATCH
 
 /* MATCH expands to the tuple containing the value.
  * NOMATCH expands to next to continue the search. */
@@ -619,11 +926,14 @@ __pragma(warning(disable:4003))
             ); \
     } \
     \
+    /* declare fixture thunks (if any) */ \
+    MIRROR_IMPL_DECLARE_FIXTURE_THUNKS(id, fixture_type, a, b, c, d, e, f, g, h) \
+    \
     /* declare and register test */ \
     MIRROR_IMPL_REGISTER(id, a, b, c, d, e, f, g, h) \
     \
     /* open test */ \
-    static void GHOST_CONCAT(mirror_TEST_, id)(fixture_type fixture_name)
+    static void GHOST_CONCAT(mirror_TEST_, id)(fixture_type fixture_name, param_type param_name)
 
 
 
@@ -642,6 +952,15 @@ __pragma(warning(disable:4003))
 #endif
 
 #define MIRROR_IMPL_REGISTER(testid, a, b, c, d, e, f, g, h) \
+    MIRROR_IMPL_REGISTER_BEGIN(testid) \
+        \
+        /* generate optional info */ \
+        MIRROR_IMPL_TEST_INFO(testid, a, b, c, d, e, f, g, h) \
+        \
+    MIRROR_IMPL_REGISTER_END
+
+/* The registration block around the test info, shared with the fast path */
+#define MIRROR_IMPL_REGISTER_BEGIN(testid) \
     MIRROR_REGISTRATION_BLOCK(testid) { \
         \
         /* declare test case info */ \
@@ -651,14 +970,12 @@ __pragma(warning(disable:4003))
         test.file = __FILE__; \
         test.line = __LINE__; \
         test.name = MIRROR_NAME; \
-        /*printf("registering %i %s\n",testid, test.name);*/ \
-        \
-        /* generate optional info */ \
-        MIRROR_IMPL_TEST_INFO(testid, a, b, c, d, e, f, g, h) \
-        \
+        /*printf("registering %i %s\n",testid, test.name);*/
+
+#define MIRROR_IMPL_REGISTER_END \
         /* register the test case */ \
         mirror_register_test(&test); \
-    } \
+    }
 
 
 
@@ -706,21 +1023,38 @@ __pragma(warning(disable:4003))
 #define MIRROR_IMPL_TEST_INFO_mirror_id MIRROR_IMPL_TEST_INFO_id
 #define MIRROR_IMPL_TEST_INFO_mirror_it MIRROR_IMPL_TEST_INFO_it
 #define MIRROR_IMPL_TEST_INFO_mirror_fixture MIRROR_IMPL_TEST_INFO_fixture
+#define MIRROR_IMPL_TEST_INFO_mirror_corpus MIRROR_IMPL_TEST_INFO_corpus
 #define MIRROR_IMPL_TEST_INFO_mirror_death MIRROR_IMPL_TEST_INFO_death
 #define MIRROR_IMPL_TEST_INFO_mirror_setup MIRROR_IMPL_TEST_INFO_setup
 #define MIRROR_IMPL_TEST_INFO_mirror_teardown MIRROR_IMPL_TEST_INFO_teardown
 #define MIRROR_IMPL_TEST_INFO_mirror_name MIRROR_IMPL_TEST_INFO_name
 #define MIRROR_IMPL_TEST_INFO_mirror_nothing MIRROR_IMPL_TEST_INFO_nothing
+#define MIRROR_IMPL_TEST_INFO_mirror_deps MIRROR_IMPL_TEST_INFO_deps
+#define MIRROR_IMPL_TEST_INFO_mirror_smoke MIRROR_IMPL_TEST_INFO_smoke
+#define MIRROR_IMPL_TEST_INFO_mirror_skip MIRROR_IMPL_TEST_INFO_skip
+#define MIRROR_IMPL_TEST_INFO_mirror_timeout MIRROR_IMPL_TEST_INFO_timeout
+#define MIRROR_IMPL_TEST_INFO_mirror_param MIRROR_IMPL_TEST_INFO_param
+#define MIRROR_IMPL_TEST_INFO_mirror_params MIRROR_IMPL_TEST_INFO_params
+#define MIRROR_IMPL_TEST_INFO_mirror_property MIRROR_IMPL_TEST_INFO_property
+/* (suite() has no prefixed form since mirror_suite() declares a suite.) */
 
 /* forward mirror-prefixed arg options */
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_id MIRROR_IMPL_TEST_INFO_OPTIONS_id
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_it MIRROR_IMPL_TEST_INFO_OPTIONS_it
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_fixture MIRROR_IMPL_TEST_INFO_OPTIONS_fixture
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_corpus MIRROR_IMPL_TEST_INFO_OPTIONS_corpus
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_death MIRROR_IMPL_TEST_INFO_OPTIONS_death
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_setup MIRROR_IMPL_TEST_INFO_OPTIONS_setup
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_teardown MIRROR_IMPL_TEST_INFO_OPTIONS_teardown
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_nothing MIRROR_IMPL_TEST_INFO_OPTIONS_nothing
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_name MIRROR_IMPL_TEST_INFO_OPTIONS_name
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_deps MIRROR_IMPL_TEST_INFO_OPTIONS_deps
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_skip MIRROR_IMPL_TEST_INFO_OPTIONS_skip
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_smoke MIRROR_IMPL_TEST_INFO_OPTIONS_smoke
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_timeout MIRROR_IMPL_TEST_INFO_OPTIONS_timeout
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_param MIRROR_IMPL_TEST_INFO_OPTIONS_param
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_params MIRROR_IMPL_TEST_INFO_OPTIONS_params
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_mirror_property MIRROR_IMPL_TEST_INFO_OPTIONS_property
 
 /* unused options */
 #define MIRROR_IMPL_TEST_INFO_ MIRROR_EAT_2
@@ -729,15 +1063,31 @@ __pragma(warning(disable:4003))
 
 /* info follows */
 
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_corpus(path) path
+#define MIRROR_IMPL_TEST_INFO_corpus(path) MIRROR_IMPL_TEST_INFO_corpus_2
+#define MIRROR_IMPL_TEST_INFO_corpus_2(id, path) test.corpus = path;
+
 #define MIRROR_IMPL_TEST_INFO_death(id, junk) test.death = ghost_true;
 
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_fixture(type, name) type, name
 #define MIRROR_IMPL_TEST_INFO_fixture(type, name) MIRROR_IMPL_TEST_INFO_fixture_2
 #define MIRROR_IMPL_TEST_INFO_fixture_2(id, type, name) test.fixture_size = sizeof(type);
 
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_param(type, name) type, name
+#define MIRROR_IMPL_TEST_INFO_param(type, name) MIRROR_IMPL_TEST_INFO_param_2
+#define MIRROR_IMPL_TEST_INFO_param_2(id, type, name) test.param_size = sizeof(type);
+
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_params(p) p
+#define MIRROR_IMPL_TEST_INFO_params(p) MIRROR_IMPL_TEST_INFO_params_2
+#define MIRROR_IMPL_TEST_INFO_params_2(id, p) test.params = p;
+
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_property(p) p
+#define MIRROR_IMPL_TEST_INFO_property(p) MIRROR_IMPL_TEST_INFO_property_2
+#define MIRROR_IMPL_TEST_INFO_property_2(id, p) test.property = p;
+
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_name(fn) fn
 #define MIRROR_IMPL_TEST_INFO_name(fn) MIRROR_IMPL_TEST_INFO_name_2
-#define MIRROR_IMPL_TEST_INFO_name_2(id, n) test.name = n;
+#define MIRROR_IMPL_TEST_INFO_name_2(id, n) test.name = n; test.named = ghost_true;
 
 #define MIRROR_IMPL_TEST_INFO_OPTIONS_setup(fn) fn
 #define MIRROR_IMPL_TEST_INFO_setup(fn) MIRROR_IMPL_TEST_INFO_setup_2
@@ -751,6 +1101,27 @@ __pragma(warning(disable:4003))
 #define MIRROR_IMPL_TEST_INFO_it(fn) MIRROR_IMPL_TEST_INFO_it_2
 #define MIRROR_IMPL_TEST_INFO_it_2(id, it) test.description = it;
 
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_timeout(ms) ms
+#define MIRROR_IMPL_TEST_INFO_timeout(ms) MIRROR_IMPL_TEST_INFO_timeout_2
+#define MIRROR_IMPL_TEST_INFO_timeout_2(id, ms) test.timeout = (ms);
+
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_suite(s) s
+#define MIRROR_IMPL_TEST_INFO_suite(s) MIRROR_IMPL_TEST_INFO_suite_2
+#define MIRROR_IMPL_TEST_INFO_suite_2(id, s) test.suite_name = s;
+
+#define MIRROR_IMPL_TEST_INFO_skip(id, junk) test.skip = ghost_true;
+
+#define MIRROR_IMPL_TEST_INFO_smoke(id, junk) test.smoke = ghost_true;
+
+/* deps() takes the names of the tests this one depends on. */
+#define MIRROR_IMPL_TEST_INFO_OPTIONS_deps(...) __VA_ARGS__
+#define MIRROR_IMPL_TEST_INFO_deps(...) MIRROR_IMPL_TEST_INFO_deps_2
+#define MIRROR_IMPL_TEST_INFO_deps_2(id, ...) { \
+        static const char* deps[] = {__VA_ARGS__}; \
+        test.deps = deps; \
+        test.deps_count = sizeof(deps) / sizeof(*deps); \
+    }
+
 
 
 /*
@@ -793,10 +1164,18 @@ __pragma(warning(disable:4003))
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_name MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_name
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_it MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_it
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_fixture MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_fixture
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_corpus MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_corpus
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_death MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_death
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_setup MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_setup
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_teardown MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_teardown
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_nothing MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_nothing
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_deps MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_deps
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_smoke MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_smoke
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_skip MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_skip
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_timeout MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_timeout
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_param MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_param
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_params MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_params
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_mirror_property MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_property
 
 /* forward mirror-prefixed arg options (that we care about) */
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_OPTIONS_mirror_setup MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_OPTIONS_setup
@@ -804,12 +1183,21 @@ __pragma(warning(disable:4003))
 
 /* all the stuff that doesn't involve fixture thunks */
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_ MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_corpus(path) MIRROR_EAT_3
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_death MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_deps(...) MIRROR_EAT_3
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_fixture(type, name) MIRROR_EAT_3
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_id(id) MIRROR_EAT_3
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_it(id) MIRROR_EAT_3
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_name(name) MIRROR_EAT_3
 #define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_nothing MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_param(type, name) MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_params(p) MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_property(p) MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_skip MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_smoke MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_suite(s) MIRROR_EAT_3
+#define MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_timeout(ms) MIRROR_EAT_3
 
 /* our actual fixture thunks */
 
@@ -831,6 +1219,259 @@ __pragma(warning(disable:4003))
 
 
 
+/**
+ * @def mirror_suite(name, fixture_type, setup, teardown)
+ *
+ * Declares a suite with a fixture shared by its tests. Tests join it with the
+ * suite() option and get the fixture by declaring a fixture() of the same
+ * type:
+ *
+ *     static FILE* zero_open(void) { return fopen("/dev/zero", "rb"); }
+ *     static void zero_close(FILE* file) { fclose(file); }
+ *
+ *     mirror_suite("file/zero", FILE*, zero_open, zero_close);
+ *
+ *     mirror(name("file/zero/getc"), suite("file/zero"), fixture(FILE*, file)) {
+ *         mirror_check(getc(file) == 0);
+ *     }
+ *
+ * The fixture is set up by the first test of the suite that takes it on each
+ * worker (thread or process) and torn down when the worker is done, so an
+ * expensive fixture is built once per worker instead of once per test. Tests
+ * that run on the same worker share whatever the fixture points to.
+ *
+ * A test in a suite can't have its own setup() or teardown(). The suite can
+ * be declared in a different file from its tests.
+ */
+#define mirror_suite(suite_name, fixture_type, setup_fn, teardown_fn) \
+    MIRROR_IMPL_SUITE(GHOST_CONCAT(MIRROR_KEY, GHOST_COUNTER), suite_name, fixture_type, setup_fn, teardown_fn)
+
+#define MIRROR_IMPL_SUITE(id, suite_name, fixture_type, setup_fn, teardown_fn) \
+    \
+    /* declare fixture thunks */ \
+    MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_setup_2(id, fixture_type, setup_fn) \
+    MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_teardown_2(id, fixture_type, teardown_fn) \
+    \
+    /* declare and register suite */ \
+    MIRROR_REGISTRATION_BLOCK(id) { \
+        static mirror_suite_t suite; \
+        suite.name = suite_name; \
+        suite.file = __FILE__; \
+        suite.line = __LINE__; \
+        suite.fixture_size = sizeof(fixture_type); \
+        suite.fixture_setup = GHOST_CONCAT(mirror_SETUP_THUNK_, id); \
+        suite.fixture_teardown = GHOST_CONCAT(mirror_TEARDOWN_THUNK_, id); \
+        mirror_register_suite(&suite); \
+    } \
+    \
+    /* swallow the semicolon */ \
+    typedef int GHOST_CONCAT(mirror_SUITE_, id)
+
+
+
+/*
+ * Fast path
+ *
+ * The portable expansion above pads every test out to eight arguments and
+ * then scans all eight once for each of id(), fixture() and param() and again
+ * for the test info, with extra expansions at each step for the MSVC
+ * traditional preprocessor. That's hundreds of expansions per test whatever
+ * its options, and in large test files preprocessing dominates compile time.
+ *
+ * A conforming C99/C++11 preprocessor doesn't need any of that. Here mirror()
+ * dispatches on its argument count and makes one pass over the arguments it
+ * was actually given, folding id(), fixture() and param() into a state tuple:
+ *
+ *     (id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name)
+ *
+ * Each argument is pasted onto MIRROR_IMPL_FAST_SCAN_ to find out what it
+ * does to the state. A second pass generates the test info and fixture thunks
+ * with the same tables as the portable path, minus the deferred expansions.
+ *
+ * This is on by default where Ghost says the preprocessor supports variadic
+ * macros and isn't MSVC's traditional preprocessor. Define
+ * MIRROR_IMPL_FAST_PP to 0 to use the portable path instead. The generated
+ * code is the same either way. `make -f test/Makefile bench-preprocess`
+ * compares the two.
+ */
+
+#define MIRROR_IMPL_FAST_PICK(a, b, c, d, e, f, g, h, n, ...) n
+#define MIRROR_IMPL_FAST_UNPACK(...) __VA_ARGS__
+
+/* The initial state. This is where the default id takes the next counter. */
+#define MIRROR_IMPL_FAST_START \
+    (GHOST_CONCAT(MIRROR_KEY, GHOST_COUNTER), \
+        mirror_fixtureNONE, mirror_nothing, mirror_nothing, \
+        mirror_paramNONE, mirror_nothing, mirror_nothing)
+
+#define MIRROR_IMPL_FAST_1(a) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_START, a), 1, a)
+#define MIRROR_IMPL_FAST_2(a, b) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_START, \
+        a), b), 2, a, b)
+#define MIRROR_IMPL_FAST_3(a, b, c) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_START, a), b), c), 3, a, b, c)
+#define MIRROR_IMPL_FAST_4(a, b, c, d) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_START, a), b), c), d), 4, a, b, c, d)
+#define MIRROR_IMPL_FAST_5(a, b, c, d, e) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_START, a), b), c), d), e), \
+        5, a, b, c, d, e)
+#define MIRROR_IMPL_FAST_6(a, b, c, d, e, f) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_START, \
+        a), b), c), d), e), f), 6, a, b, c, d, e, f)
+#define MIRROR_IMPL_FAST_7(a, b, c, d, e, f, g) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_START, a), b), c), d), e), f), g), 7, a, b, c, d, e, f, g)
+#define MIRROR_IMPL_FAST_8(a, b, c, d, e, f, g, h) \
+    MIRROR_IMPL_FAST_EMIT(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_STEP( \
+        MIRROR_IMPL_FAST_STEP(MIRROR_IMPL_FAST_START, a), b), c), d), e), f), g), h), \
+        8, a, b, c, d, e, f, g, h)
+
+/* Applies one argument to the state. The scan gives an operation and up to
+ * two values for it. */
+#define MIRROR_IMPL_FAST_STEP(state, arg) \
+    MIRROR_IMPL_FAST_STEP_2(MIRROR_IMPL_FAST_SCAN_##arg, MIRROR_IMPL_FAST_UNPACK state)
+#define MIRROR_IMPL_FAST_STEP_2(...) MIRROR_IMPL_FAST_STEP_3(__VA_ARGS__)
+#define MIRROR_IMPL_FAST_STEP_3(op, x, y, id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name) \
+    op(x, y, id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name)
+
+#define MIRROR_IMPL_FAST_KEEP(x, y, id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name) \
+    (id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name)
+#define MIRROR_IMPL_FAST_SET_ID(x, y, id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name) \
+    (x, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name)
+#define MIRROR_IMPL_FAST_SET_FIXTURE(x, y, id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name) \
+    (id, mirror_fixture, x, y, is_param, param_type, param_name)
+#define MIRROR_IMPL_FAST_SET_PARAM(x, y, id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name) \
+    (id, is_fixture, fixture_type, fixture_name, mirror_param, x, y)
+
+/* What each argument does to the state */
+#define MIRROR_IMPL_FAST_SCAN_ MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_corpus(path) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_death MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_deps(...) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_fixture(type, name) MIRROR_IMPL_FAST_SET_FIXTURE, type, name
+#define MIRROR_IMPL_FAST_SCAN_id(id) MIRROR_IMPL_FAST_SET_ID, id, ~
+#define MIRROR_IMPL_FAST_SCAN_it(desc) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_name(n) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_nothing MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_param(type, name) MIRROR_IMPL_FAST_SET_PARAM, type, name
+#define MIRROR_IMPL_FAST_SCAN_params(p) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_property(p) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_setup(fn) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_skip MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_smoke MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_suite(s) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_teardown(fn) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_timeout(ms) MIRROR_IMPL_FAST_KEEP, ~, ~
+#define MIRROR_IMPL_FAST_SCAN_mirror_corpus MIRROR_IMPL_FAST_SCAN_corpus
+#define MIRROR_IMPL_FAST_SCAN_mirror_death MIRROR_IMPL_FAST_SCAN_death
+#define MIRROR_IMPL_FAST_SCAN_mirror_deps MIRROR_IMPL_FAST_SCAN_deps
+#define MIRROR_IMPL_FAST_SCAN_mirror_fixture MIRROR_IMPL_FAST_SCAN_fixture
+#define MIRROR_IMPL_FAST_SCAN_mirror_id MIRROR_IMPL_FAST_SCAN_id
+#define MIRROR_IMPL_FAST_SCAN_mirror_it MIRROR_IMPL_FAST_SCAN_it
+#define MIRROR_IMPL_FAST_SCAN_mirror_name MIRROR_IMPL_FAST_SCAN_name
+#define MIRROR_IMPL_FAST_SCAN_mirror_nothing MIRROR_IMPL_FAST_SCAN_nothing
+#define MIRROR_IMPL_FAST_SCAN_mirror_param MIRROR_IMPL_FAST_SCAN_param
+#define MIRROR_IMPL_FAST_SCAN_mirror_params MIRROR_IMPL_FAST_SCAN_params
+#define MIRROR_IMPL_FAST_SCAN_mirror_property MIRROR_IMPL_FAST_SCAN_property
+#define MIRROR_IMPL_FAST_SCAN_mirror_setup MIRROR_IMPL_FAST_SCAN_setup
+#define MIRROR_IMPL_FAST_SCAN_mirror_skip MIRROR_IMPL_FAST_SCAN_skip
+#define MIRROR_IMPL_FAST_SCAN_mirror_smoke MIRROR_IMPL_FAST_SCAN_smoke
+#define MIRROR_IMPL_FAST_SCAN_mirror_teardown MIRROR_IMPL_FAST_SCAN_teardown
+#define MIRROR_IMPL_FAST_SCAN_mirror_timeout MIRROR_IMPL_FAST_SCAN_timeout
+
+/* Unpacks the final state and picks the variant. */
+#define MIRROR_IMPL_FAST_EMIT(state, ...) \
+    MIRROR_IMPL_FAST_EMIT_2(MIRROR_IMPL_FAST_UNPACK state, __VA_ARGS__)
+#define MIRROR_IMPL_FAST_EMIT_2(...) MIRROR_IMPL_FAST_EMIT_3(__VA_ARGS__)
+#define MIRROR_IMPL_FAST_EMIT_3(id, is_fixture, fixture_type, fixture_name, is_param, param_type, param_name, ...) \
+    MIRROR_IMPL_FAST_##is_fixture##_##is_param(id, fixture_type, fixture_name, param_type, param_name, __VA_ARGS__)
+
+/* Calls m(x, y, arg) for each of the n arguments. */
+#define MIRROR_IMPL_FAST_EACH_1(m, x, y, a) m(x, y, a)
+#define MIRROR_IMPL_FAST_EACH_2(m, x, y, a, b) m(x, y, a) m(x, y, b)
+#define MIRROR_IMPL_FAST_EACH_3(m, x, y, a, b, c) m(x, y, a) m(x, y, b) m(x, y, c)
+#define MIRROR_IMPL_FAST_EACH_4(m, x, y, a, b, c, d) m(x, y, a) m(x, y, b) m(x, y, c) m(x, y, d)
+#define MIRROR_IMPL_FAST_EACH_5(m, x, y, a, b, c, d, e) \
+    MIRROR_IMPL_FAST_EACH_4(m, x, y, a, b, c, d) m(x, y, e)
+#define MIRROR_IMPL_FAST_EACH_6(m, x, y, a, b, c, d, e, f) \
+    MIRROR_IMPL_FAST_EACH_4(m, x, y, a, b, c, d) m(x, y, e) m(x, y, f)
+#define MIRROR_IMPL_FAST_EACH_7(m, x, y, a, b, c, d, e, f, g) \
+    MIRROR_IMPL_FAST_EACH_4(m, x, y, a, b, c, d) m(x, y, e) m(x, y, f) m(x, y, g)
+#define MIRROR_IMPL_FAST_EACH_8(m, x, y, a, b, c, d, e, f, g, h) \
+    MIRROR_IMPL_FAST_EACH_4(m, x, y, a, b, c, d) m(x, y, e) m(x, y, f) m(x, y, g) m(x, y, h)
+
+/* The options are expanded before the call so that their commas separate
+ * arguments. */
+#define MIRROR_IMPL_FAST_CALL(macro, args) macro args
+#define MIRROR_IMPL_FAST_TEST_INFO(id, junk, arg) \
+    MIRROR_IMPL_FAST_CALL(MIRROR_IMPL_TEST_INFO_##arg, (id, MIRROR_IMPL_TEST_INFO_OPTIONS_##arg))
+#define MIRROR_IMPL_FAST_FIXTURE_THUNKS(id, fixture_type, arg) \
+    MIRROR_IMPL_FAST_CALL(MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_##arg, \
+            (id, fixture_type, MIRROR_IMPL_DECLARE_FIXTURE_THUNKS_OPTIONS_##arg))
+
+#define MIRROR_IMPL_FAST_REGISTER(id, n, ...) \
+    MIRROR_IMPL_REGISTER_BEGIN(id) \
+        MIRROR_IMPL_FAST_EACH_##n(MIRROR_IMPL_FAST_TEST_INFO, id, ~, __VA_ARGS__) \
+    MIRROR_IMPL_REGISTER_END
+
+/* The variants, as MIRROR_IMPL_*() above */
+
+#define MIRROR_IMPL_FAST_mirror_fixtureNONE_mirror_paramNONE( \
+        id, fixture_type, fixture_name, param_type, param_name, n, ...) \
+    static void mirror_TEST_##id(void); \
+    static void mirror_THUNK_##id(void* vfixture, void* vparam) { \
+        ghost_discard(vfixture); \
+        ghost_discard(vparam); \
+        mirror_TEST_##id(); \
+    } \
+    MIRROR_IMPL_FAST_REGISTER(id, n, __VA_ARGS__) \
+    static void mirror_TEST_##id(void)
+
+#define MIRROR_IMPL_FAST_mirror_fixture_mirror_paramNONE( \
+        id, fixture_type, fixture_name, param_type, param_name, n, ...) \
+    static void mirror_TEST_##id(fixture_type fixture_name); \
+    static void mirror_THUNK_##id(void* vfixture, void* vparam) { \
+        ghost_discard(vparam); \
+        typedef fixture_type mirror_FIXTURE_type_##id; \
+        mirror_TEST_##id(*ghost_static_cast(mirror_FIXTURE_type_##id*, vfixture)); \
+    } \
+    MIRROR_IMPL_FAST_EACH_##n(MIRROR_IMPL_FAST_FIXTURE_THUNKS, id, fixture_type, __VA_ARGS__) \
+    MIRROR_IMPL_FAST_REGISTER(id, n, __VA_ARGS__) \
+    static void mirror_TEST_##id(fixture_type fixture_name)
+
+#define MIRROR_IMPL_FAST_mirror_fixtureNONE_mirror_param( \
+        id, fixture_type, fixture_name, param_type, param_name, n, ...) \
+    static void mirror_TEST_##id(param_type param_name); \
+    static void mirror_THUNK_##id(void* vfixture, void* vparam) { \
+        ghost_discard(vfixture); \
+        typedef param_type mirror_PARAM_type_##id; \
+        mirror_TEST_##id(*ghost_static_cast(mirror_PARAM_type_##id*, vparam)); \
+    } \
+    MIRROR_IMPL_FAST_REGISTER(id, n, __VA_ARGS__) \
+    static void mirror_TEST_##id(param_type param_name)
+
+#define MIRROR_IMPL_FAST_mirror_fixture_mirror_param( \
+        id, fixture_type, fixture_name, param_type, param_name, n, ...) \
+    static void mirror_TEST_##id(fixture_type fixture_name, param_type param_name); \
+    static void mirror_THUNK_##id(void* vfixture, void* vparam) { \
+        typedef fixture_type mirror_FIXTURE_type_##id; \
+        typedef param_type mirror_PARAM_type_##id; \
+        mirror_TEST_##id(*ghost_static_cast(mirror_FIXTURE_type_##id*, vfixture), \
+                *ghost_static_cast(mirror_PARAM_type_##id*, vparam)); \
+    } \
+    MIRROR_IMPL_FAST_EACH_##n(MIRROR_IMPL_FAST_FIXTURE_THUNKS, id, fixture_type, __VA_ARGS__) \
+    MIRROR_IMPL_FAST_REGISTER(id, n, __VA_ARGS__) \
+    static void mirror_TEST_##id(fixture_type fixture_name, param_type param_name)
+
+
+
 
 
 
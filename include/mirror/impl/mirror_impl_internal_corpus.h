@@ -0,0 +1,303 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_CORPUS_H
+#define MIRROR_IMPL_INTERNAL_CORPUS_H
+
+/*
+ * The internal runner's corpora (the corpus() option).
+ *
+ * The corpora of the tests that are going to run are loaded before any
+ * workers start. Each file is mapped read-only so worker threads share it
+ * and forked worker processes inherit it, sharing its pages rather than
+ * reading it again. A corpus used by several tests is loaded once.
+ *
+ * Without POSIX a corpus must be a single file. It is read into memory.
+ */
+
+#include "mirror/impl/mirror_impl_runner_common.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <errno.h>
+#include <string.h>
+
+#if MIRROR_POSIX
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+typedef struct mirror_corpus_t mirror_corpus_t;
+
+struct mirror_corpus_t {
+    const char* path;
+    mirror_record_t* records;
+    char** names;    /* of each record */
+    void** mappings; /* of each record, or null if it's empty */
+    ghost_size_t count;
+    ghost_bool failed; /* it couldn't be loaded */
+    mirror_corpus_t* /*nullable*/ next;
+};
+
+static mirror_corpus_t* /*nullable*/ mirror_impl_corpora;
+
+/* Stands in for the data of empty files, which can't be mapped. */
+static const char mirror_impl_corpus_empty[1] = {0};
+
+static char* /*nullable*/ mirror_corpus_copy(const char* string) {
+    ghost_size_t size = strlen(string) + 1;
+    char* copy = ghost_static_cast(char*, ghost_calloc(size, 1));
+    if (copy != ghost_null)
+        memcpy(copy, string, size);
+    return copy;
+}
+
+/* Maps (or reads) the file at the record's name. */
+static ghost_bool mirror_corpus_map(mirror_record_t* record, void** mapping) {
+    #if MIRROR_POSIX
+    struct stat info;
+    int fd = open(record->name, O_RDONLY);
+    if (fd < 0)
+        return ghost_false;
+    if (0 != fstat(fd, &info)) {
+        close(fd);
+        return ghost_false;
+    }
+    record->size = ghost_static_cast(ghost_size_t, info.st_size);
+    record->data = mirror_impl_corpus_empty;
+    if (record->size != 0) {
+        *mapping = mmap(ghost_null, record->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*mapping == MAP_FAILED) {
+            *mapping = ghost_null;
+            close(fd);
+            return ghost_false;
+        }
+        record->data = *mapping;
+    }
+    close(fd);
+    return ghost_true;
+    #else
+    FILE* file = fopen(record->name, "rb");
+    long size;
+    if (file == ghost_null)
+        return ghost_false;
+    if (0 != fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 || 0 != fseek(file, 0, SEEK_SET)) {
+        fclose(file);
+        return ghost_false;
+    }
+    record->size = ghost_static_cast(ghost_size_t, size);
+    record->data = mirror_impl_corpus_empty;
+    if (record->size != 0) {
+        *mapping = ghost_calloc(record->size, 1);
+        if (*mapping == ghost_null || record->size != fread(*mapping, 1, record->size, file)) {
+            fclose(file);
+            return ghost_false;
+        }
+        record->data = *mapping;
+    }
+    fclose(file);
+    return ghost_true;
+    #endif
+}
+
+static void mirror_corpus_unmap(void* /*nullable*/ mapping, ghost_size_t size) {
+    if (mapping == ghost_null)
+        return;
+    #if MIRROR_POSIX
+    munmap(mapping, size);
+    #else
+    (void)size;
+    ghost_free(mapping);
+    #endif
+}
+
+ghost_maybe_unused
+static int mirror_corpus_compare(const void* vleft, const void* vright) {
+    const char* const* left = ghost_static_cast(const char* const*, vleft);
+    const char* const* right = ghost_static_cast(const char* const*, vright);
+    return strcmp(*left, *right);
+}
+
+/*
+ * Names the records of a corpus: the regular files in it if it's a
+ * directory, otherwise the corpus itself.
+ */
+static ghost_bool mirror_corpus_list(mirror_corpus_t* corpus) {
+    #if MIRROR_POSIX
+    struct stat info;
+    DIR* dir;
+    struct dirent* entry;
+    ghost_size_t capacity = 16;
+    ghost_size_t length = strlen(corpus->path);
+    char* name;
+    char** grown;
+
+    if (0 != stat(corpus->path, &info))
+        return ghost_false;
+    if (!S_ISDIR(info.st_mode)) {
+    #endif
+        corpus->names = ghost_static_cast(char**, ghost_calloc(1, sizeof(char*)));
+        if (corpus->names == ghost_null)
+            return ghost_false;
+        corpus->names[0] = mirror_corpus_copy(corpus->path);
+        corpus->count = (corpus->names[0] != ghost_null) ? 1 : 0;
+        return corpus->count == 1;
+    #if MIRROR_POSIX
+    }
+
+    dir = opendir(corpus->path);
+    if (dir == ghost_null)
+        return ghost_false;
+    corpus->names = ghost_static_cast(char**, ghost_calloc(capacity, sizeof(char*)));
+    if (corpus->names == ghost_null) {
+        closedir(dir);
+        return ghost_false;
+    }
+
+    /* Hidden files are left out. */
+    while ((entry = readdir(dir)) != ghost_null) {
+        if (entry->d_name[0] == '.')
+            continue;
+        name = ghost_static_cast(char*, ghost_calloc(length + strlen(entry->d_name) + 2, 1));
+        if (name == ghost_null)
+            break;
+        memcpy(name, corpus->path, length);
+        name[length] = '/';
+        memcpy(name + length + 1, entry->d_name, strlen(entry->d_name));
+        if (0 != stat(name, &info) || !S_ISREG(info.st_mode)) {
+            ghost_free(name);
+            continue;
+        }
+
+        if (corpus->count == capacity) {
+            capacity *= 2;
+            grown = ghost_static_cast(char**, ghost_calloc(capacity, sizeof(char*)));
+            if (grown == ghost_null) {
+                ghost_free(name);
+                break;
+            }
+            memcpy(grown, corpus->names, corpus->count * sizeof(char*));
+            ghost_free(corpus->names);
+            corpus->names = grown;
+        }
+        corpus->names[corpus->count++] = name;
+    }
+    closedir(dir);
+    if (entry != ghost_null)
+        return ghost_false;
+
+    qsort(corpus->names, corpus->count, sizeof(char*), mirror_corpus_compare);
+    return ghost_true;
+    #endif
+}
+
+/* Returns the corpus at the given path, loading it if it isn't already. */
+static mirror_corpus_t* mirror_corpus_open(const char* path) {
+    mirror_corpus_t* corpus;
+    ghost_size_t i;
+
+    for (corpus = mirror_impl_corpora; corpus != ghost_null; corpus = corpus->next)
+        if (0 == strcmp(corpus->path, path))
+            return corpus;
+
+    corpus = ghost_static_cast(mirror_corpus_t*, ghost_calloc(1, sizeof(mirror_corpus_t)));
+    if (corpus == ghost_null) {
+        fprintf(stderr, "Failed to allocate corpus %s.\n", path);
+        ghost_abort();
+    }
+    corpus->path = path;
+    corpus->next = mirror_impl_corpora;
+    mirror_impl_corpora = corpus;
+
+    if (!mirror_corpus_list(corpus)) {
+        printf("Failed to load corpus %s: %s\n", path, strerror(errno));
+        corpus->failed = ghost_true;
+        return corpus;
+    }
+
+    corpus->records = ghost_static_cast(mirror_record_t*, ghost_calloc(corpus->count + 1, sizeof(mirror_record_t)));
+    corpus->mappings = ghost_static_cast(void**, ghost_calloc(corpus->count + 1, sizeof(void*)));
+    if (corpus->records == ghost_null || corpus->mappings == ghost_null) {
+        fprintf(stderr, "Failed to allocate corpus %s.\n", path);
+        ghost_abort();
+    }
+    for (i = 0; i < corpus->count; ++i) {
+        corpus->records[i].name = corpus->names[i];
+        if (!mirror_corpus_map(&corpus->records[i], &corpus->mappings[i])) {
+            printf("Failed to load %s: %s\n", corpus->records[i].name, strerror(errno));
+            corpus->failed = ghost_true;
+            break;
+        }
+    }
+    return corpus;
+}
+
+/*
+ * Loads the corpora of the given tests and gives each test its records. A
+ * test whose corpus can't be loaded fails without running.
+ */
+static void mirror_corpus_load(mirror_test_t** tests, ghost_size_t count) {
+    mirror_corpus_t* corpus;
+    ghost_size_t i;
+
+    for (i = 0; i < count; ++i) {
+        mirror_test_t* test = tests[i];
+        if (test->corpus == ghost_null || test->status != mirror_status_none)
+            continue;
+        corpus = mirror_corpus_open(test->corpus);
+        if (corpus->failed) {
+            printf("Test \"%s\" (%s:%i) failed: its corpus %s couldn't be loaded.\n",
+                    test->name, test->file, test->line, test->corpus);
+            test->status = mirror_status_fail;
+            continue;
+        }
+        test->params.array = corpus->records;
+        test->params.count = corpus->count;
+    }
+    fflush(stdout);
+}
+
+static void mirror_corpus_unload(void) {
+    mirror_corpus_t* corpus;
+    ghost_size_t i;
+
+    while (mirror_impl_corpora != ghost_null) {
+        corpus = mirror_impl_corpora;
+        mirror_impl_corpora = corpus->next;
+        for (i = 0; i < corpus->count; ++i) {
+            if (corpus->mappings != ghost_null)
+                mirror_corpus_unmap(corpus->mappings[i], corpus->records[i].size);
+            ghost_free(corpus->names[i]);
+        }
+        ghost_free(corpus->mappings);
+        ghost_free(corpus->records);
+        ghost_free(corpus->names);
+        ghost_free(corpus);
+    }
+}
+
+#endif
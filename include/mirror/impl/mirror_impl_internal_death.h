@@ -0,0 +1,266 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_DEATH_H
+#define MIRROR_IMPL_INTERNAL_DEATH_H
+
+/*
+ * Death tests of the internal runner.
+ *
+ * A death test runs in a child process and passes if the child aborts. It
+ * fails if it returns, if a check in it fails or if it dies some other way.
+ *
+ * Children are forked, never exec'd, so they start with the registry already
+ * built. A worker process under --fork is single-threaded so it forks its
+ * death tests itself. A death test enforces its own timeout with alarm() so
+ * that a hung one fails alone without bringing down the run. Otherwise the
+ * runner may have threads (workers and the watchdog) which must not be
+ * forked, so before starting any of them it forks one fork server per
+ * worker. A fork server is a copy of the runner that does nothing but fork
+ * death tests on request and report how they died.
+ */
+
+#include "mirror/impl/mirror_impl_internal_fork.h"
+#include "mirror/impl/mirror_impl_runner_common.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+
+#if MIRROR_FORK
+
+/* The exit code of a death test child in which a check failed. */
+#define MIRROR_IMPL_DEATH_CHECK_FAILED 3
+
+typedef struct mirror_death_server_t {
+    pid_t pid;    /* 0 if not running */
+    int requests; /* write end; tests are sent here */
+    int results;  /* read end; wait statuses are received here */
+} mirror_death_server_t;
+
+/* The fork servers of the in-process workers, indexed by worker. */
+static mirror_death_server_t* mirror_impl_death_servers;
+static ghost_size_t mirror_impl_death_server_count;
+
+/*
+ * Forks a child to run the given death test and waits for it. Returns its
+ * wait status.
+ */
+static int mirror_death_fork(mirror_test_t* test) {
+    mirror_worker_t worker = GHOST_ZERO_INIT;
+    unsigned long timeout;
+    int status = 0;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+        perror("Failed to fork death test");
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* Expected aborts shouldn't spend time writing core dumps. */
+        struct rlimit limit;
+        limit.rlim_cur = limit.rlim_max = 0;
+        setrlimit(RLIMIT_CORE, &limit);
+
+        /* Whoever is enforcing the timeout may not be able to reach us, so
+         * we enforce it ourselves. Rounded up to whole seconds. */
+        timeout = ghost_static_cast(unsigned long, (mirror_impl_timeout(test) + 999999999u) / 1000000000u);
+        if (timeout > 0xffffffffu)
+            timeout = 0xffffffffu;
+        if (timeout != 0)
+            alarm(ghost_static_cast(unsigned, timeout));
+
+        /* A failed check must unwind to our exit code rather than abort
+         * (with --fail-fast) or it would look like the death we expect. */
+        mirror_impl_fail_fast = ghost_false;
+
+        /* A death test in a suite sets up its own copy of the shared fixture
+         * here. It isn't torn down since we're expecting to die. */
+        mirror_impl_worker = &worker;
+        worker.test = test;
+        worker.status = mirror_status_none;
+        mirror_run_body(&worker, test);
+        fflush(stdout);
+        fflush(stderr);
+        _exit((worker.status == mirror_status_none) ? EXIT_SUCCESS : MIRROR_IMPL_DEATH_CHECK_FAILED);
+    }
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            perror("Failed to wait for death test");
+            return -1;
+        }
+    }
+    return status;
+}
+
+/* Records the result of a death test from how its child died. */
+static void mirror_death_result(mirror_test_t* test, int status) {
+    if (status == -1) {
+        test->status = mirror_status_fail;
+    } else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT) {
+        test->status = mirror_status_pass;
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == MIRROR_IMPL_DEATH_CHECK_FAILED) {
+        /* The check already reported itself. */
+        test->status = mirror_status_fail;
+    } else if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM && mirror_impl_timeout(test) != 0) {
+        test->status = mirror_status_timeout;
+        mirror_impl_output_lock();
+        printf("Test \"%s\" (%s:%i, id %s) timed out after %lu ms.\n",
+                test->name, test->file, test->line, test->id,
+                ghost_static_cast(unsigned long, mirror_impl_timeout(test) / 1000000u));
+        fflush(stdout);
+        mirror_impl_output_unlock();
+    } else {
+        test->status = mirror_status_fail;
+        mirror_impl_output_lock();
+        if (WIFSIGNALED(status))
+            printf("Test \"%s\" (%s:%i) should have aborted but died with signal %i.\n",
+                    test->name, test->file, test->line, WTERMSIG(status));
+        else
+            printf("Test \"%s\" (%s:%i) should have aborted but exited with status %i.\n",
+                    test->name, test->file, test->line, WEXITSTATUS(status));
+        fflush(stdout);
+        mirror_impl_output_unlock();
+    }
+}
+
+/* Runs a death test from a worker process under --fork. */
+static void mirror_death_run_forked(mirror_worker_t* worker, mirror_test_t* test) {
+    (void)worker;
+    mirror_death_result(test, mirror_death_fork(test));
+}
+
+/* Runs a death test through the calling worker's fork server. */
+static void mirror_death_run_served(mirror_worker_t* worker, mirror_test_t* test) {
+    mirror_death_server_t* server = &mirror_impl_death_servers[worker->index];
+    int status = -1;
+    if (!mirror_fork_write(server->requests, &test->handle, sizeof(test->handle)) ||
+            !mirror_fork_read(server->results, &status, sizeof(status)))
+    {
+        mirror_impl_output_lock();
+        printf("Test \"%s\" (%s:%i) could not be run: its fork server is gone.\n",
+                test->name, test->file, test->line);
+        fflush(stdout);
+        mirror_impl_output_unlock();
+        status = -1;
+    }
+    mirror_death_result(test, status);
+}
+
+/* The main loop of a fork server. This never returns. */
+static void mirror_death_serve(int requests, int results) {
+    mirror_test_t* test;
+    ghost_uint32_t handle;
+    int status;
+    while (mirror_fork_read(requests, &handle, sizeof(handle)) &&
+            (test = mirror_registry_test(handle)) != ghost_null)
+    {
+        status = mirror_death_fork(test);
+        if (!mirror_fork_write(results, &status, sizeof(status)))
+            break;
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/* Returns true if any of the given tests is a death test. */
+static ghost_bool mirror_death_any(mirror_test_t** tests, ghost_size_t count) {
+    ghost_size_t i;
+    for (i = 0; i < count; ++i)
+        if (tests[i]->death)
+            return ghost_true;
+    return ghost_false;
+}
+
+/*
+ * Starts the given number of fork servers, one for each in-process worker.
+ * This must be called before any threads are started.
+ */
+static void mirror_death_start(ghost_size_t count) {
+    mirror_death_server_t* servers;
+    int requests[2];
+    int results[2];
+    ghost_size_t i, j;
+
+    servers = ghost_static_cast(mirror_death_server_t*, ghost_calloc(count, sizeof(mirror_death_server_t)));
+    if (servers == ghost_null) {
+        fprintf(stderr, "Failed to allocate %" GHOST_PRIuZ " fork servers.\n", count);
+        ghost_abort();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for (i = 0; i < count; ++i) {
+        if (0 != pipe(requests) || 0 != pipe(results)) {
+            perror("Failed to create pipes for fork server");
+            ghost_abort();
+        }
+        servers[i].pid = fork();
+        if (servers[i].pid < 0) {
+            perror("Failed to fork fork server");
+            ghost_abort();
+        }
+        if (servers[i].pid == 0) {
+            for (j = 0; j < i; ++j) {
+                close(servers[j].requests);
+                close(servers[j].results);
+            }
+            close(requests[1]);
+            close(results[0]);
+            mirror_death_serve(requests[0], results[1]);
+        }
+        close(requests[0]);
+        close(results[1]);
+        servers[i].requests = requests[1];
+        servers[i].results = results[0];
+    }
+
+    mirror_impl_death_servers = servers;
+    mirror_impl_death_server_count = count;
+    mirror_impl_death_runner = mirror_death_run_served;
+}
+
+/* Stops the fork servers, if any. */
+static void mirror_death_stop(void) {
+    ghost_size_t i;
+    int status;
+    for (i = 0; i < mirror_impl_death_server_count; ++i) {
+        close(mirror_impl_death_servers[i].requests);
+        close(mirror_impl_death_servers[i].results);
+        while (waitpid(mirror_impl_death_servers[i].pid, &status, 0) < 0 && errno == EINTR)
+            ;
+    }
+    ghost_free(mirror_impl_death_servers);
+    mirror_impl_death_servers = ghost_null;
+    mirror_impl_death_server_count = 0;
+    mirror_impl_death_runner = ghost_null;
+}
+
+#endif
+
+#endif
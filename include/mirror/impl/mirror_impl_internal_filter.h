@@ -0,0 +1,345 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_FILTER_H
+#define MIRROR_IMPL_INTERNAL_FILTER_H
+
+/*
+ * Selecting tests by name with --filter and --filter-regex.
+ *
+ * The filter has the same syntax as GoogleTest's: a colon-separated list of
+ * positive patterns, optionally followed by a dash and a colon-separated list
+ * of negative patterns. A test is selected if its name matches any positive
+ * pattern (or there are none) and no negative pattern. In a pattern, '*'
+ * matches any run of characters and '?' matches any single character.
+ *
+ * Tests are sorted by name in the registry so the tests matching a pattern
+ * all lie in the range of names starting with its literal part (everything
+ * before its first wildcard.) We find the start of each range with a lookup
+ * in the registry tree and walk only while names keep the prefix. Running one
+ * subsystem's tests out of a large binary therefore costs a logarithmic
+ * lookup plus the tests actually selected. A positive pattern that starts
+ * with a wildcard, or a filter with no positive patterns, has to look at
+ * every test. A pattern with no wildcards at all is an exact name, which the
+ * registry finds by hash.
+ *
+ * --filter-regex further restricts the selected tests to those whose name
+ * matches a POSIX extended regular expression. It's only available on POSIX.
+ */
+
+#include "mirror/impl/mirror_impl_internal_options.h"
+#include "mirror/impl/mirror_impl_internal_registry.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+#if MIRROR_POSIX
+    #include <regex.h>
+#endif
+
+/* One pattern of a filter. It points into the filter string. */
+typedef struct mirror_filter_pattern_t {
+    const char* start;
+    const char* end;
+    ghost_size_t literal; /* length of the part before the first wildcard */
+    ghost_bool negative;
+} mirror_filter_pattern_t;
+
+/* A range of the registry by index. */
+typedef struct mirror_filter_range_t {
+    ghost_size_t begin;
+    ghost_size_t end;
+} mirror_filter_range_t;
+
+typedef struct mirror_filter_t {
+    mirror_filter_pattern_t* patterns;
+    ghost_size_t count;
+    ghost_size_t positive; /* number of positive patterns */
+    #if MIRROR_POSIX
+    regex_t regex;
+    #endif
+    ghost_bool has_regex;
+} mirror_filter_t;
+
+/* Returns true if the given name matches the given glob. */
+static ghost_bool mirror_filter_glob(const char* pattern, const char* pattern_end, const char* name) {
+    const char* star = ghost_null; /* the last '*' seen */
+    const char* resume = ghost_null; /* where in name to retry after it */
+
+    for (;;) {
+        if (pattern != pattern_end && *pattern == '*') {
+            star = ++pattern;
+            resume = name;
+        } else if (pattern != pattern_end && *name != '\0' && (*pattern == '?' || *pattern == *name)) {
+            ++pattern;
+            ++name;
+        } else if (pattern == pattern_end && *name == '\0') {
+            return ghost_true;
+        } else if (star != ghost_null && *resume != '\0') {
+            /* Let the last '*' swallow one more character and try again. */
+            pattern = star;
+            name = ++resume;
+        } else {
+            return ghost_false;
+        }
+    }
+}
+
+static void mirror_filter_destroy(mirror_filter_t* filter) {
+    ghost_free(filter->patterns);
+    #if MIRROR_POSIX
+    if (filter->has_regex)
+        regfree(&filter->regex);
+    #endif
+}
+
+/* Parses the filter options. Exits on an invalid regex. */
+static void mirror_filter_init(mirror_filter_t* filter, const mirror_options_t* options) {
+    const char* string = options->filter;
+    const char* start;
+    mirror_filter_pattern_t* pattern;
+    ghost_bool negative = ghost_false;
+    ghost_size_t capacity = 1;
+    const char* p;
+
+    filter->patterns = ghost_null;
+    filter->count = 0;
+    filter->positive = 0;
+    filter->has_regex = ghost_false;
+
+    if (string != ghost_null) {
+        for (p = string; *p != '\0'; ++p)
+            if (*p == ':' || *p == '-')
+                ++capacity;
+        filter->patterns = ghost_static_cast(mirror_filter_pattern_t*,
+                ghost_calloc(capacity, sizeof(mirror_filter_pattern_t)));
+        if (filter->patterns == ghost_null) {
+            fprintf(stderr, "Failed to allocate filter.\n");
+            ghost_abort();
+        }
+
+        for (start = p = string;; ++p) {
+            if (*p != '\0' && *p != ':' && !(*p == '-' && !negative))
+                continue;
+            if (p != start) {
+                pattern = &filter->patterns[filter->count++];
+                pattern->start = start;
+                pattern->end = p;
+                pattern->negative = negative;
+                pattern->literal = 0;
+                while (start + pattern->literal != p &&
+                        start[pattern->literal] != '*' && start[pattern->literal] != '?')
+                    ++pattern->literal;
+                if (!negative)
+                    ++filter->positive;
+            }
+            if (*p == '\0')
+                break;
+            if (*p == '-')
+                negative = ghost_true;
+            start = p + 1;
+        }
+    }
+
+    if (options->filter_regex != ghost_null) {
+        #if MIRROR_POSIX
+        int error = regcomp(&filter->regex, options->filter_regex, REG_EXTENDED | REG_NOSUB);
+        if (error != 0) {
+            char message[256];
+            regerror(error, &filter->regex, message, sizeof(message));
+            fprintf(stderr, "Invalid --filter-regex \"%s\": %s\n", options->filter_regex, message);
+            exit(EXIT_FAILURE);
+        }
+        filter->has_regex = ghost_true;
+        #else
+        fprintf(stderr, "This build of mirror does not support --filter-regex.\n");
+        exit(EXIT_FAILURE);
+        #endif
+    }
+}
+
+static ghost_bool mirror_filter_match(const mirror_filter_t* filter, const mirror_test_t* test) {
+    const mirror_filter_pattern_t* pattern;
+    ghost_bool positive = (filter->positive == 0);
+    ghost_size_t i;
+
+    for (i = 0; i < filter->count && !positive; ++i) {
+        pattern = &filter->patterns[i];
+        if (!pattern->negative && mirror_filter_glob(pattern->start, pattern->end, test->name))
+            positive = ghost_true;
+    }
+    if (!positive)
+        return ghost_false;
+
+    for (i = 0; i < filter->count; ++i) {
+        pattern = &filter->patterns[i];
+        if (pattern->negative && mirror_filter_glob(pattern->start, pattern->end, test->name))
+            return ghost_false;
+    }
+
+    #if MIRROR_POSIX
+    if (filter->has_regex && 0 != regexec(&filter->regex, test->name, 0, ghost_null, 0))
+        return ghost_false;
+    #endif
+    return ghost_true;
+}
+
+/*
+ * Finds the range of the registry whose names start with the literal part of
+ * the given pattern.
+ */
+static mirror_filter_range_t mirror_filter_range(mirror_all_tests_t* all,
+        const mirror_filter_pattern_t* pattern, char* buffer)
+{
+    mirror_filter_range_t range;
+    mirror_strkey_t key;
+    mirror_test_t* test;
+    ghost_uint32_t name_id;
+    ghost_bool equal;
+
+    range.begin = 0;
+    range.end = mirror_impl_registry_count;
+    if (pattern->literal == 0)
+        return range;
+
+    memcpy(buffer, pattern->start, pattern->literal);
+    buffer[pattern->literal] = '\0';
+
+    /* A pattern without wildcards is just a name so we can hash it. */
+    if (pattern->start + pattern->literal == pattern->end) {
+        range.begin = mirror_registry_find_name(buffer);
+        if (range.begin == MIRROR_REGISTRY_NONE) {
+            range.begin = range.end;
+            return range;
+        }
+        name_id = mirror_impl_registry_tests[range.begin]->name_id;
+        range.end = range.begin;
+        while (range.end < mirror_impl_registry_count &&
+                mirror_impl_registry_tests[range.end]->name_id == name_id)
+            ++range.end;
+        return range;
+    }
+
+    mirror_strkey_init(&key, buffer);
+
+    /* The first test whose name isn't less than the prefix */
+    test = mirror_all_tests_find_before(all, &key, &equal);
+    if (!equal)
+        test = (test == ghost_null) ? mirror_all_tests_first(all) : mirror_all_tests_next(all, test);
+    if (test == ghost_null) {
+        range.begin = range.end;
+        return range;
+    }
+
+    /* The registry is in tree order so the rest of the range follows in it. */
+    range.begin = test->handle;
+    range.end = range.begin;
+    while (range.end < mirror_impl_registry_count &&
+            0 == strncmp(mirror_impl_registry_tests[range.end]->name, buffer, pattern->literal))
+        ++range.end;
+    return range;
+}
+
+static int mirror_filter_range_compare(const void* vleft, const void* vright) {
+    const mirror_filter_range_t* left = ghost_static_cast(const mirror_filter_range_t*, vleft);
+    const mirror_filter_range_t* right = ghost_static_cast(const mirror_filter_range_t*, vright);
+    return (left->begin < right->begin) ? -1 : (left->begin > right->begin);
+}
+
+/*
+ * Selects the tests that pass the filter in registry order. The returned
+ * array must be freed and has room for all registered tests.
+ */
+static mirror_test_t** mirror_filter_select(const mirror_options_t* options, ghost_size_t* out_count) {
+    mirror_all_tests_t* all = mirror_all_tests();
+    ghost_size_t total = mirror_impl_registry_count;
+    mirror_filter_range_t* ranges = ghost_null;
+    mirror_filter_range_t whole;
+    mirror_filter_t filter;
+    mirror_test_t** tests;
+    mirror_test_t* test;
+    ghost_size_t count = 0;
+    ghost_size_t range_count = 0;
+    ghost_size_t i, j, end;
+    char* buffer = ghost_null;
+
+    tests = ghost_static_cast(mirror_test_t**, ghost_calloc(total + 1, sizeof(mirror_test_t*)));
+    if (tests == ghost_null) {
+        fprintf(stderr, "Failed to allocate list of %" GHOST_PRIuZ " tests.\n", total);
+        ghost_abort();
+    }
+
+    if (options->filter == ghost_null && options->filter_regex == ghost_null) {
+        memcpy(tests, mirror_impl_registry_tests, total * sizeof(mirror_test_t*));
+        *out_count = total;
+        return tests;
+    }
+
+    /* Each positive pattern narrows the search to a range of the registry.
+     * Without any, we search everything. */
+    mirror_filter_init(&filter, options);
+    whole.begin = 0;
+    whole.end = total;
+    if (filter.positive != 0) {
+        ranges = ghost_static_cast(mirror_filter_range_t*,
+                ghost_calloc(filter.positive, sizeof(mirror_filter_range_t)));
+        buffer = ghost_static_cast(char*, ghost_calloc(strlen(options->filter) + 1, 1));
+        if (ranges == ghost_null || buffer == ghost_null) {
+            fprintf(stderr, "Failed to allocate filter.\n");
+            ghost_abort();
+        }
+        for (i = 0; i < filter.count; ++i)
+            if (!filter.patterns[i].negative)
+                ranges[range_count++] = mirror_filter_range(all, &filter.patterns[i], buffer);
+        qsort(ranges, range_count, sizeof(mirror_filter_range_t), mirror_filter_range_compare);
+    } else {
+        ranges = &whole;
+        range_count = 1;
+    }
+
+    /* Walk the ranges in order, merging overlaps so no test is seen twice. */
+    end = 0;
+    for (i = 0; i < range_count; ++i) {
+        j = (ranges[i].begin > end) ? ranges[i].begin : end;
+        if (j >= ranges[i].end)
+            continue;
+        for (; j < ranges[i].end; ++j) {
+            test = mirror_impl_registry_tests[j];
+            if (mirror_filter_match(&filter, test))
+                tests[count++] = test;
+        }
+        end = ranges[i].end;
+    }
+
+    if (ranges != &whole)
+        ghost_free(ranges);
+    ghost_free(buffer);
+    mirror_filter_destroy(&filter);
+    *out_count = count;
+    return tests;
+}
+
+#endif
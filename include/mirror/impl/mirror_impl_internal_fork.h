@@ -0,0 +1,474 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_FORK_H
+#define MIRROR_IMPL_INTERNAL_FORK_H
+
+/*
+ * The internal runner's process pool (--fork).
+ *
+ * The parent forks a set of long-lived worker processes and hands them tests
+ * one at a time from the scheduler over a pipe. Each worker runs the test and
+ * writes its status back on another pipe. The parent times each test itself
+ * so that it also knows how long a crashed test ran, and kills any worker
+ * whose test runs past its timeout. A worker that dies takes only its current
+ * test with it: the parent reaps it, records the test as failed or crashed,
+ * and forks a replacement to carry on with the rest of the tests.
+ *
+ * A parameterized test is sent in chunks of instances. The parent claims each
+ * chunk just before sending it so that the chunks of one test spread over as
+ * many workers as the scheduler gave it entries, and the worker that finishes
+ * a chunk is sent the next one.
+ *
+ * With --fail-fast the parent stops handing out tests after the first one
+ * that doesn't pass and waits for the running ones to finish.
+ */
+
+#include "mirror/impl/mirror_impl_internal_registry.h"
+#include "mirror/impl/mirror_impl_internal_sched.h"
+
+#if MIRROR_FORK
+
+typedef struct mirror_fork_worker_t {
+    pid_t pid;         /* 0 if not running */
+    int requests;      /* write end; tests are sent here */
+    int results;       /* read end; test results are received here */
+    mirror_test_t* /*nullable*/ test; /* the test it's running */
+    ghost_uint64_t first;   /* the instances it's running, if parameterized */
+    ghost_uint64_t end;
+    ghost_uint64_t started; /* when the test was sent */
+    ghost_uint64_t deadline; /* when the test times out, or 0 */
+    ghost_bool killed;       /* we killed it because the test timed out */
+} mirror_fork_worker_t;
+
+/* What the parent sends to run a test. */
+typedef struct mirror_fork_request_t {
+    ghost_uint32_t handle;
+    ghost_uint32_t reserved;
+    ghost_uint64_t first; /* instances of a parameterized test */
+    ghost_uint64_t end;
+} mirror_fork_request_t;
+
+/* What a worker sends back after each test. */
+typedef struct mirror_fork_result_t {
+    ghost_uint64_t cpu_user;
+    ghost_uint64_t cpu_system;
+    ghost_uint32_t status; /* mirror_status_t */
+} mirror_fork_result_t;
+
+/* In a worker process, the pipe on which results are written. */
+static int mirror_impl_fork_results = -1;
+
+static ghost_bool mirror_fork_write(int fd, const void* vbuffer, ghost_size_t size) {
+    const char* buffer = ghost_static_cast(const char*, vbuffer);
+    while (size > 0) {
+        ssize_t step = write(fd, buffer, size);
+        if (step < 0) {
+            if (errno == EINTR)
+                continue;
+            return ghost_false;
+        }
+        buffer += step;
+        size -= ghost_static_cast(ghost_size_t, step);
+    }
+    return ghost_true;
+}
+
+/* Returns false on error or if the pipe is closed before size bytes arrive. */
+static ghost_bool mirror_fork_read(int fd, void* vbuffer, ghost_size_t size) {
+    char* buffer = ghost_static_cast(char*, vbuffer);
+    while (size > 0) {
+        ssize_t step = read(fd, buffer, size);
+        if (step < 0) {
+            if (errno == EINTR)
+                continue;
+            return ghost_false;
+        }
+        if (step == 0)
+            return ghost_false;
+        buffer += step;
+        size -= ghost_static_cast(ghost_size_t, step);
+    }
+    return ghost_true;
+}
+
+/* Reports a failed check to the parent before the worker aborts (with
+ * --fail-fast.) */
+static void mirror_fork_failure_hook(mirror_worker_t* worker) {
+    mirror_fork_result_t result = GHOST_ZERO_INIT;
+    (void)worker;
+    result.status = mirror_status_fail;
+    mirror_fork_write(mirror_impl_fork_results, &result, sizeof(result));
+}
+
+/*
+ * The main loop of a worker process. This never returns.
+ *
+ * Tests are sent as their registry handles. The worker is a fork of the
+ * parent so it has the same registry.
+ */
+static void mirror_fork_child(ghost_size_t index, int requests, int results) {
+    mirror_worker_t worker = GHOST_ZERO_INIT;
+    mirror_test_t* test;
+    mirror_fork_request_t request;
+    mirror_fork_result_t result = GHOST_ZERO_INIT;
+
+    worker.index = index;
+    worker.failure_hook = mirror_fork_failure_hook;
+    mirror_impl_fork_results = results;
+
+    while (mirror_fork_read(requests, &request, sizeof(request)) &&
+            (test = mirror_registry_test(request.handle)) != ghost_null)
+    {
+        worker.params_first = request.first;
+        worker.params_end = request.end;
+        mirror_run(&worker, test);
+        fflush(stdout);
+        result.cpu_user = worker.cpu_user;
+        result.cpu_system = worker.cpu_system;
+        result.status = worker.status;
+        if (!mirror_fork_write(results, &result, sizeof(result)))
+            break;
+    }
+
+    mirror_worker_finish(&worker);
+    fflush(stdout);
+    fflush(stderr);
+    _exit(EXIT_SUCCESS);
+}
+
+static void mirror_fork_spawn(mirror_fork_worker_t* workers, ghost_size_t jobs, ghost_size_t index) {
+    mirror_fork_worker_t* worker = &workers[index];
+    int requests[2];
+    int results[2];
+    ghost_size_t i;
+
+    if (0 != pipe(requests) || 0 != pipe(results)) {
+        perror("Failed to create pipes for worker process");
+        ghost_abort();
+    }
+
+    /* Anything still buffered would otherwise be written again by the child. */
+    fflush(stdout);
+    fflush(stderr);
+
+    worker->pid = fork();
+    if (worker->pid < 0) {
+        perror("Failed to fork worker process");
+        ghost_abort();
+    }
+
+    if (worker->pid == 0) {
+        for (i = 0; i < jobs; ++i) {
+            if (i != index && workers[i].pid != 0) {
+                close(workers[i].requests);
+                close(workers[i].results);
+            }
+        }
+        close(requests[1]);
+        close(results[0]);
+        mirror_fork_child(index, requests[0], results[1]);
+    }
+
+    close(requests[0]);
+    close(results[1]);
+    worker->requests = requests[1];
+    worker->results = results[0];
+    worker->test = ghost_null;
+}
+
+/*
+ * Claims the next chunk of a parameterized test for the worker to run.
+ * Returns false if there's nothing left to claim. Other tests are always
+ * sent whole.
+ */
+static ghost_bool mirror_fork_claim(mirror_fork_worker_t* worker, mirror_test_t* test) {
+    worker->first = worker->end = 0;
+    if (test->param_size == 0)
+        return ghost_true;
+    return mirror_params_claim(test, &worker->first, &worker->end);
+}
+
+/*
+ * Hands the worker the given test (having claimed its instances if it's
+ * parameterized), or closes its request pipe (which tells it to exit) if the
+ * test is null.
+ */
+static void mirror_fork_send(mirror_fork_worker_t* worker, mirror_test_t* /*nullable*/ test) {
+    mirror_fork_request_t request = GHOST_ZERO_INIT;
+    ghost_uint64_t chunk;
+
+    if (test == ghost_null) {
+        if (worker->requests != -1) {
+            close(worker->requests);
+            worker->requests = -1;
+        }
+        return;
+    }
+
+    /* If the write fails the worker is dead. We'll find out when we read its
+     * results pipe and the test will be reported as crashed. */
+    worker->test = test;
+    worker->started = mirror_time_now();
+    worker->deadline = mirror_impl_timeout(test);
+    if (test->param_size != 0) {
+        chunk = worker->end - worker->first;
+        worker->deadline = (chunk != 0 && worker->deadline > MIRROR_IMPL_TIMEOUT_MAX * 1000000u / chunk) ?
+                MIRROR_IMPL_TIMEOUT_MAX * 1000000u : worker->deadline * chunk;
+    }
+    if (worker->deadline != 0)
+        worker->deadline += worker->started;
+    request.handle = test->handle;
+    request.first = worker->first;
+    request.end = worker->end;
+    mirror_fork_write(worker->requests, &request, sizeof(request));
+}
+
+/*
+ * Reaps a worker whose results pipe has closed. If it died in the middle of a
+ * test without reporting, the test is recorded as failed (if it aborted) or
+ * crashed (anything else).
+ */
+static void mirror_fork_reap(mirror_fork_worker_t* worker) {
+    mirror_test_t* test = worker->test;
+    ghost_bool killed = worker->killed;
+    int status = 0;
+
+    while (waitpid(worker->pid, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    if (worker->requests != -1)
+        close(worker->requests);
+    close(worker->results);
+    worker->pid = 0;
+    worker->requests = -1;
+    worker->results = -1;
+    worker->test = ghost_null;
+    worker->deadline = 0;
+    worker->killed = ghost_false;
+
+    /* A timed out test has already been reported. */
+    if (test == ghost_null || killed)
+        return;
+
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT) {
+        mirror_impl_record(test, mirror_status_fail, mirror_time_now() - worker->started, 0, 0);
+        printf("Test \"%s\" (%s:%i) aborted.\n", test->name, test->file, test->line);
+    } else {
+        mirror_impl_record(test, mirror_status_crash, mirror_time_now() - worker->started, 0, 0);
+        if (WIFSIGNALED(status))
+            printf("Test \"%s\" (%s:%i) crashed with signal %i.\n",
+                    test->name, test->file, test->line, WTERMSIG(status));
+        else
+            printf("Test \"%s\" (%s:%i) crashed: worker exited with status %i.\n",
+                    test->name, test->file, test->line, WEXITSTATUS(status));
+    }
+    if (test->param_size != 0)
+        printf("    It was running instances %lu to %lu.\n",
+                ghost_static_cast(unsigned long, worker->first),
+                ghost_static_cast(unsigned long, worker->end - 1));
+    if (test->property.generate != ghost_null)
+        printf("    Its property ran with --seed=%lu.\n", ghost_static_cast(unsigned long, mirror_impl_seed));
+    fflush(stdout);
+}
+
+/*
+ * Kills the workers whose tests have run past their deadline. Returns the
+ * poll() timeout until the next deadline, or -1 if there is none.
+ */
+static int mirror_fork_expire(mirror_fork_worker_t* workers, ghost_size_t jobs) {
+    ghost_uint64_t now = mirror_time_now();
+    ghost_uint64_t wait = 0;
+    ghost_size_t i;
+
+    for (i = 0; i < jobs; ++i) {
+        mirror_fork_worker_t* worker = &workers[i];
+        mirror_test_t* test = worker->test;
+        if (worker->pid == 0 || test == ghost_null || worker->deadline == 0 || worker->killed)
+            continue;
+
+        if (worker->deadline <= now) {
+            kill(worker->pid, SIGKILL);
+            worker->killed = ghost_true;
+            mirror_impl_record(test, mirror_status_timeout, now - worker->started, 0, 0);
+            printf("Test \"%s\" (%s:%i, id %s) timed out after %lu ms.\n",
+                    test->name, test->file, test->line, test->id,
+                    ghost_static_cast(unsigned long, (worker->deadline - worker->started) / 1000000u));
+            fflush(stdout);
+            continue;
+        }
+
+        if (wait == 0 || worker->deadline - now < wait)
+            wait = worker->deadline - now;
+    }
+
+    if (wait == 0)
+        return -1;
+    /* Round up so we don't wake up just before the deadline. */
+    wait = (wait + 999999u) / 1000000u;
+    return (wait > 1000000u) ? 1000000 : ghost_static_cast(int, wait);
+}
+
+/*
+ * Gives work to the workers that have none, forking replacements for dead
+ * ones if there's work for them. A worker with nothing to do is told to exit
+ * unless tests are still waiting on dependencies, in which case it idles
+ * until they're released. Returns the number of workers started.
+ */
+static ghost_size_t mirror_fork_dispatch(mirror_fork_worker_t* workers, ghost_size_t jobs,
+        mirror_sched_t* sched, ghost_bool stop)
+{
+    ghost_size_t started = 0;
+    ghost_size_t i;
+    mirror_test_t* test;
+
+    for (i = 0; i < jobs; ++i) {
+        mirror_fork_worker_t* worker = &workers[i];
+        if (worker->test != ghost_null || (worker->pid != 0 && worker->requests == -1))
+            continue;
+
+        /* A parameterized test may have no instances left to claim. */
+        for (;;) {
+            test = stop ? ghost_null : mirror_sched_take(sched, i);
+            if (test == ghost_null || mirror_fork_claim(worker, test))
+                break;
+            mirror_sched_done(sched, test);
+        }
+        if (test != ghost_null) {
+            if (worker->pid == 0) {
+                mirror_fork_spawn(workers, jobs, i);
+                ++started;
+            }
+            mirror_fork_send(worker, test);
+        } else if (worker->pid != 0 && (stop || !mirror_sched_pending(sched))) {
+            mirror_fork_send(worker, ghost_null);
+        }
+    }
+
+    return started;
+}
+
+/*
+ * Runs the scheduled tests on one worker process per deque, returning once
+ * all of them have run. The status of each test is recorded in the test.
+ */
+static void mirror_fork_run(mirror_sched_t* sched) {
+    mirror_fork_worker_t* workers;
+    struct pollfd* fds;
+    ghost_size_t* polled; /* index of the worker for each entry in fds */
+    ghost_size_t jobs = sched->workers;
+    ghost_size_t running;
+    ghost_size_t i, n;
+    ghost_bool stop = ghost_false;
+    mirror_test_t* test;
+    mirror_fork_result_t result;
+
+    workers = ghost_static_cast(mirror_fork_worker_t*, ghost_calloc(jobs, sizeof(mirror_fork_worker_t)));
+    fds = ghost_static_cast(struct pollfd*, ghost_calloc(jobs, sizeof(struct pollfd)));
+    polled = ghost_static_cast(ghost_size_t*, ghost_calloc(jobs, sizeof(ghost_size_t)));
+    if (workers == ghost_null || fds == ghost_null || polled == ghost_null) {
+        fprintf(stderr, "Failed to allocate %" GHOST_PRIuZ " workers.\n", jobs);
+        ghost_abort();
+    }
+
+    /* A worker may die while we're writing to it. We want EPIPE, not death. */
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < jobs; ++i)
+        mirror_fork_spawn(workers, jobs, i);
+    running = jobs;
+    mirror_fork_dispatch(workers, jobs, sched, stop);
+
+    while (running > 0) {
+        n = 0;
+        for (i = 0; i < jobs; ++i) {
+            if (workers[i].pid == 0)
+                continue;
+            fds[n].fd = workers[i].results;
+            fds[n].events = POLLIN;
+            fds[n].revents = 0;
+            polled[n++] = i;
+        }
+
+        if (poll(fds, ghost_static_cast(nfds_t, n), mirror_fork_expire(workers, jobs)) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("Failed to poll worker processes");
+            ghost_abort();
+        }
+
+        for (i = 0; i < n; ++i) {
+            mirror_fork_worker_t* worker = &workers[polled[i]];
+            if (fds[i].revents == 0)
+                continue;
+
+            if (!worker->killed && mirror_fork_read(worker->results, &result, sizeof(result))) {
+                test = worker->test;
+                mirror_impl_record(test, ghost_static_cast(mirror_status_t, result.status),
+                        mirror_time_now() - worker->started, result.cpu_user, result.cpu_system);
+                /* A worker that failed with --fail-fast is about to abort;
+                 * don't give it more work. */
+                if (result.status != mirror_status_pass && mirror_impl_fail_fast) {
+                    worker->test = ghost_null;
+                    mirror_sched_done(sched, test);
+                    stop = ghost_true;
+                    mirror_fork_send(worker, ghost_null);
+                    continue;
+                }
+                /* The same worker carries on with the next chunk of a
+                 * parameterized test. */
+                if (test->param_size != 0 && !stop && mirror_fork_claim(worker, test)) {
+                    mirror_fork_send(worker, test);
+                    continue;
+                }
+                worker->test = ghost_null;
+                mirror_sched_done(sched, test);
+                continue;
+            }
+
+            /* The worker has exited. If it died in the middle of a test,
+             * that test didn't pass. It's replaced below if there's more to
+             * do. */
+            test = worker->test;
+            mirror_fork_reap(worker);
+            --running;
+            if (test != ghost_null) {
+                mirror_sched_done(sched, test);
+                if (mirror_impl_fail_fast)
+                    stop = ghost_true;
+            }
+        }
+
+        running += mirror_fork_dispatch(workers, jobs, sched, stop);
+    }
+
+    signal(SIGPIPE, SIG_DFL);
+    ghost_free(polled);
+    ghost_free(fds);
+    ghost_free(workers);
+}
+
+#endif
+
+#endif
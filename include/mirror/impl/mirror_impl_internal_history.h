@@ -0,0 +1,438 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_HISTORY_H
+#define MIRROR_IMPL_INTERNAL_HISTORY_H
+
+/*
+ * The result history of the internal runner.
+ *
+ * After each run a compact binary record of every test is saved: a hash of
+ * its file and name (its key, see mirror_registry_key()), a fingerprint of
+ * its source, its status and its duration. The next run loads it so that
+ * tests which failed last time can run first, followed by tests whose source
+ * has changed (or that are new), with the slowest of each going first.
+ * --only-failed runs just the tests that failed last time.
+ *
+ * The fingerprint is a hash of the test's file and line along with the size
+ * and modification time of its source file if it can be found. This catches
+ * most edits to a test or to anything above it in the same file.
+ *
+ * The history is only a hint. A missing, stale or corrupt file just means
+ * tests are scheduled as if they were new.
+ *
+ * Records for tests that didn't run (for example because they're in another
+ * shard) are carried over when the history is saved, including those saved
+ * by another run since this one started.
+ *
+ * The file is a header followed by fixed-size little-endian records:
+ *
+ *     header: "MIRRORH" followed by a version byte of 2
+ *     record: u64 key, u64 fingerprint, u64 duration in nanoseconds,
+ *             u32 status (mirror_status_t), u32 reserved
+ */
+
+#include "mirror/impl/mirror_impl_internal_registry.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+#if MIRROR_POSIX
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#endif
+
+#define MIRROR_IMPL_HISTORY_MAGIC "MIRRORH\002"
+#define MIRROR_IMPL_HISTORY_HEADER_SIZE 8
+#define MIRROR_IMPL_HISTORY_RECORD_SIZE 32
+
+typedef struct mirror_history_entry_t {
+    ghost_uint64_t key;
+    ghost_uint64_t fingerprint;
+    ghost_uint64_t duration;
+    mirror_status_t status;
+    ghost_bool saved; /* already written by a test in this run */
+} mirror_history_entry_t;
+
+typedef struct mirror_history_t {
+    mirror_history_entry_t* entries; /* sorted by key */
+    ghost_size_t count;
+    mirror_history_entry_t** by_handle; /* of each test, or null if not indexed */
+} mirror_history_t;
+
+static void mirror_history_init(mirror_history_t* history) {
+    history->entries = ghost_null;
+    history->count = 0;
+    history->by_handle = ghost_null;
+}
+
+/*
+ * Returns the history file to use (which must be freed), or null if history
+ * is disabled.
+ */
+static char* /*nullable*/ mirror_history_path(const char* /*nullable*/ path, const char* program) {
+    static const char suffix[] = ".mirror-history";
+    char* result;
+
+    if (path == ghost_null) {
+        result = ghost_static_cast(char*, ghost_calloc(strlen(program) + sizeof(suffix), 1));
+        if (result != ghost_null) {
+            strcpy(result, program);
+            strcat(result, suffix);
+        }
+    } else {
+        result = ghost_static_cast(char*, ghost_calloc(strlen(path) + 1, 1));
+        if (result != ghost_null)
+            strcpy(result, path);
+    }
+    return result;
+}
+
+/* Returns the fingerprint of the test's source. Never 0. */
+static ghost_uint64_t mirror_history_fingerprint(const mirror_test_t* test) {
+    /* Tests tend to come in runs from the same file so we remember the last
+     * one we looked at. */
+    static ghost_uint32_t last_file = 0xffffffffu;
+    static ghost_uint64_t last_hash;
+    ghost_uint64_t hash;
+
+    if (last_file != test->file_id) {
+        last_file = test->file_id;
+        last_hash = mirror_mph_hash(test->file);
+        #if MIRROR_POSIX
+        {
+            struct stat info;
+            if (0 == stat(test->file, &info)) {
+                last_hash = mirror_mph_hash_uint(last_hash, ghost_static_cast(ghost_uint64_t, info.st_size));
+                last_hash = mirror_mph_hash_uint(last_hash, ghost_static_cast(ghost_uint64_t, info.st_mtime));
+            }
+        }
+        #endif
+    }
+
+    hash = mirror_mph_hash_uint(last_hash, ghost_static_cast(ghost_uint64_t, test->line));
+    return (hash == 0) ? 1 : hash;
+}
+
+static int mirror_history_compare(const void* vleft, const void* vright) {
+    const mirror_history_entry_t* left = ghost_static_cast(const mirror_history_entry_t*, vleft);
+    const mirror_history_entry_t* right = ghost_static_cast(const mirror_history_entry_t*, vright);
+    if (left->key != right->key)
+        return (left->key < right->key) ? -1 : 1;
+    return 0;
+}
+
+static void mirror_history_destroy(mirror_history_t* history) {
+    ghost_free(history->entries);
+    ghost_free(history->by_handle);
+    mirror_history_init(history);
+}
+
+/*
+ * Looks up the test of each entry in the registry so that finding a test's
+ * entry later is a single array read. If the registry can't find tests by
+ * key we leave it to binary search.
+ */
+static void mirror_history_index(mirror_history_t* history) {
+    ghost_uint32_t handle;
+    ghost_size_t i;
+
+    if (history->count == 0 || !mirror_registry_keyed())
+        return;
+    history->by_handle = ghost_static_cast(mirror_history_entry_t**,
+            ghost_calloc(mirror_impl_registry_count, sizeof(mirror_history_entry_t*)));
+    if (history->by_handle == ghost_null)
+        return;
+    for (i = 0; i < history->count; ++i) {
+        handle = mirror_registry_find_key(history->entries[i].key);
+        if (handle != MIRROR_REGISTRY_NONE)
+            history->by_handle[handle] = &history->entries[i];
+    }
+}
+
+static void mirror_history_put(unsigned char* buffer, ghost_uint64_t value, int size) {
+    int i;
+    for (i = 0; i < size; ++i, value >>= 8)
+        buffer[i] = ghost_static_cast(unsigned char, value & 0xffu);
+}
+
+static ghost_uint64_t mirror_history_get(const unsigned char* buffer, int size) {
+    ghost_uint64_t value = 0;
+    int i;
+    for (i = size - 1; i >= 0; --i)
+        value = (value << 8) | buffer[i];
+    return value;
+}
+
+/*
+ * Loads the history from the given file. If the file can't be read or isn't
+ * a history file the history is left empty.
+ */
+static void mirror_history_load(mirror_history_t* history, const char* path) {
+    unsigned char record[MIRROR_IMPL_HISTORY_RECORD_SIZE];
+    ghost_size_t capacity = 0;
+    mirror_history_entry_t* entry;
+    ghost_uint64_t status;
+    FILE* file;
+
+    mirror_history_init(history);
+    file = fopen(path, "rb");
+    if (file == ghost_null)
+        return;
+
+    if (MIRROR_IMPL_HISTORY_HEADER_SIZE != fread(record, 1, MIRROR_IMPL_HISTORY_HEADER_SIZE, file) ||
+            0 != memcmp(record, MIRROR_IMPL_HISTORY_MAGIC, MIRROR_IMPL_HISTORY_HEADER_SIZE))
+    {
+        fclose(file);
+        return;
+    }
+
+    while (MIRROR_IMPL_HISTORY_RECORD_SIZE == fread(record, 1, MIRROR_IMPL_HISTORY_RECORD_SIZE, file)) {
+        status = mirror_history_get(record + 24, 4);
+        if (status > mirror_status_blocked)
+            continue;
+        if (history->count == capacity) {
+            mirror_history_entry_t* entries;
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            entries = ghost_static_cast(mirror_history_entry_t*,
+                    ghost_calloc(capacity, sizeof(mirror_history_entry_t)));
+            if (entries == ghost_null)
+                break;
+            if (history->count != 0)
+                memcpy(entries, history->entries, history->count * sizeof(mirror_history_entry_t));
+            ghost_free(history->entries);
+            history->entries = entries;
+        }
+        entry = &history->entries[history->count++];
+        entry->key = mirror_history_get(record, 8);
+        entry->fingerprint = mirror_history_get(record + 8, 8);
+        entry->duration = mirror_history_get(record + 16, 8);
+        entry->status = ghost_static_cast(mirror_status_t, status);
+        entry->saved = ghost_false;
+    }
+    fclose(file);
+
+    if (history->count > 1)
+        qsort(history->entries, history->count, sizeof(mirror_history_entry_t),
+                mirror_history_compare);
+    mirror_history_index(history);
+}
+
+/* Returns the history entry for the given test, or null if it has none. */
+static mirror_history_entry_t* /*nullable*/ mirror_history_find(
+        const mirror_history_t* history, const mirror_test_t* test)
+{
+    mirror_history_entry_t probe;
+
+    if (history->count == 0)
+        return ghost_null;
+    if (history->by_handle != ghost_null)
+        return history->by_handle[test->handle];
+
+    probe.key = test->key;
+    return ghost_static_cast(mirror_history_entry_t*, bsearch(&probe,
+            history->entries, history->count, sizeof(mirror_history_entry_t),
+            mirror_history_compare));
+}
+
+/*
+ * Sets the expected duration, previous status and fingerprint of each test
+ * from the history, and whether it has changed since.
+ */
+static void mirror_history_apply(const mirror_history_t* history,
+        mirror_test_t** tests, ghost_size_t count)
+{
+    mirror_history_entry_t* found;
+    mirror_test_t* test;
+    ghost_size_t i;
+
+    for (i = 0; i < count; ++i) {
+        test = tests[i];
+        test->fingerprint = mirror_history_fingerprint(test);
+        found = mirror_history_find(history, test);
+        if (found == ghost_null) {
+            test->changed = ghost_true;
+            continue;
+        }
+        test->expected = found->duration;
+        test->previous = found->status;
+        test->changed = (found->fingerprint != test->fingerprint);
+    }
+}
+
+/* Returns true if the given status is a failure of a test that ran. */
+static ghost_bool mirror_history_failed(mirror_status_t status) {
+    return status == mirror_status_fail || status == mirror_status_crash ||
+            status == mirror_status_timeout;
+}
+
+/*
+ * Returns the scheduling rank of a test: 0 if it failed last time, 1 if it's
+ * new or changed, or 2 otherwise. Lower ranks run first.
+ */
+static int mirror_history_rank(const mirror_test_t* test) {
+    if (mirror_history_failed(test->previous))
+        return 0;
+    return test->changed ? 1 : 2;
+}
+
+static void mirror_history_write(FILE* file, ghost_uint64_t key, ghost_uint64_t fingerprint,
+        ghost_uint64_t duration, mirror_status_t status)
+{
+    unsigned char record[MIRROR_IMPL_HISTORY_RECORD_SIZE];
+    memset(record, 0, sizeof(record));
+    mirror_history_put(record, key, 8);
+    mirror_history_put(record + 8, fingerprint, 8);
+    mirror_history_put(record + 16, duration, 8);
+    mirror_history_put(record + 24, ghost_static_cast(ghost_uint64_t, status), 4);
+    fwrite(record, 1, sizeof(record), file);
+}
+
+/*
+ * Locks the history at the given path against other runs saving it, returning
+ * the descriptor of its lock file or -1 if it can't be locked. The lock is a
+ * separate file because the history itself is replaced rather than rewritten.
+ * Closing the descriptor releases it.
+ */
+static int mirror_history_lock(const char* path) {
+    #if MIRROR_POSIX
+    static const char suffix[] = ".lock";
+    struct flock lock;
+    char* lock_path;
+    int fd;
+
+    lock_path = ghost_static_cast(char*, ghost_calloc(strlen(path) + sizeof(suffix), 1));
+    if (lock_path == ghost_null)
+        return -1;
+    strcpy(lock_path, path);
+    strcat(lock_path, suffix);
+    fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    ghost_free(lock_path);
+    if (fd == -1)
+        return -1;
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    while (-1 == fcntl(fd, F_SETLKW, &lock)) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+    #else
+    (void)path;
+    return -1;
+    #endif
+}
+
+static void mirror_history_unlock(int lock) {
+    #if MIRROR_POSIX
+    if (lock != -1)
+        close(lock);
+    #else
+    (void)lock;
+    #endif
+}
+
+/*
+ * Saves the result of each test to the given file, along with the records
+ * of any other tests already in it. Tests with no result keep their previous
+ * record. A test that failed without running (for example on a missing
+ * dependency) still records the failure.
+ *
+ * The file is re-read under a lock just before it's replaced rather than
+ * using the history loaded at startup, so concurrent runs (such as the
+ * shards of a sharded run) merge their results instead of losing each
+ * other's. Each run writes its own temporary file and renames it over the
+ * history so an interrupted run can't leave it half-written. Without POSIX
+ * there's no lock, and of two runs saving at once one may lose its results.
+ */
+static void mirror_history_save(const char* path, mirror_test_t** tests, ghost_size_t count) {
+    mirror_history_t history;
+    mirror_history_entry_t* found;
+    mirror_test_t* test;
+    char* temp;
+    FILE* file;
+    ghost_size_t i;
+    ghost_bool ok;
+    int lock;
+
+    temp = ghost_static_cast(char*, ghost_calloc(strlen(path) + 32, 1));
+    if (temp == ghost_null)
+        return;
+    #if MIRROR_POSIX
+    sprintf(temp, "%s.%ld.tmp", path, ghost_static_cast(long, getpid()));
+    #else
+    strcpy(temp, path);
+    strcat(temp, ".tmp");
+    #endif
+
+    lock = mirror_history_lock(path);
+    mirror_history_load(&history, path);
+
+    file = fopen(temp, "wb");
+    if (file == ghost_null) {
+        mirror_history_destroy(&history);
+        mirror_history_unlock(lock);
+        ghost_free(temp);
+        return;
+    }
+
+    fwrite(MIRROR_IMPL_HISTORY_MAGIC, 1, MIRROR_IMPL_HISTORY_HEADER_SIZE, file);
+    for (i = 0; i < count; ++i) {
+        test = tests[i];
+        found = mirror_history_find(&history, test);
+        if (found != ghost_null)
+            found->saved = ghost_true;
+        if (test->status != mirror_status_none) {
+            /* A test that failed without running keeps its old duration. */
+            mirror_history_write(file, test->key, test->fingerprint,
+                    (test->duration == 0 && found != ghost_null) ? found->duration : test->duration,
+                    test->status);
+        } else if (found != ghost_null) {
+            mirror_history_write(file, found->key, found->fingerprint,
+                    found->duration, found->status);
+        }
+    }
+    for (i = 0; i < history.count; ++i)
+        if (!history.entries[i].saved)
+            mirror_history_write(file, history.entries[i].key, history.entries[i].fingerprint,
+                    history.entries[i].duration, history.entries[i].status);
+
+    ok = !ferror(file);
+    if (0 != fclose(file))
+        ok = ghost_false;
+    if (!ok || 0 != rename(temp, path))
+        remove(temp);
+    mirror_history_destroy(&history);
+    mirror_history_unlock(lock);
+    ghost_free(temp);
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_LIST_H
+#define MIRROR_IMPL_INTERNAL_LIST_H
+
+/*
+ * Listing tests with --list-tests.
+ *
+ * This is how build systems and IDEs discover tests so it has to be fast. It
+ * runs no tests (and no fixtures), loads no history and writes its whole
+ * output at once.
+ *
+ * Each test that passes the filter is listed in registry order with its id,
+ * name, file, line, flags and description. The flags are a comma-separated
+ * list of death, smoke and skip, or "-" if none apply. In the plain format
+ * the fields are separated by tabs and each test ends with a newline. In the
+ * null format every field ends with a NUL byte (so each test is six fields)
+ * which is safe for any name or description.
+ */
+
+#include "mirror/impl/mirror_impl_internal_options.h"
+#include "mirror/impl/mirror_impl_runner_common.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+/*
+ * Appends the given string and separator to the buffer, or if buffer is null,
+ * just counts them. Returns the new length.
+ */
+static ghost_size_t mirror_list_append(char* /*nullable*/ buffer, ghost_size_t length,
+        const char* string, char separator)
+{
+    ghost_size_t size = strlen(string);
+    if (buffer != ghost_null) {
+        memcpy(buffer + length, string, size);
+        buffer[length + size] = separator;
+    }
+    return length + size + 1;
+}
+
+/* Appends (or counts) the fields of a test. Returns the new length. */
+static ghost_size_t mirror_list_test(char* /*nullable*/ buffer, ghost_size_t length,
+        const mirror_test_t* test, mirror_list_format_t format)
+{
+    char separator = (format == mirror_list_format_null) ? '\0' : '\t';
+    char end = (format == mirror_list_format_null) ? '\0' : '\n';
+    char flags[sizeof(",death,smoke,skip")];
+    char line[24];
+
+    flags[0] = '\0';
+    if (test->death)
+        strcat(flags, ",death");
+    if (test->smoke)
+        strcat(flags, ",smoke");
+    if (test->skip)
+        strcat(flags, ",skip");
+    ghost_snprintf(line, sizeof(line), "%i", test->line);
+
+    length = mirror_list_append(buffer, length, test->id != ghost_null ? test->id : "", separator);
+    length = mirror_list_append(buffer, length, test->name, separator);
+    length = mirror_list_append(buffer, length, test->file, separator);
+    length = mirror_list_append(buffer, length, line, separator);
+    length = mirror_list_append(buffer, length, (flags[0] == '\0') ? "-" : flags + 1, separator);
+    return mirror_list_append(buffer, length,
+            test->description != ghost_null ? test->description : "", end);
+}
+
+/*
+ * Lists the given tests to stdout in the given format. Returns false if the
+ * output couldn't be written.
+ */
+static ghost_bool mirror_list_tests(mirror_test_t** tests, ghost_size_t count,
+        mirror_list_format_t format)
+{
+    ghost_size_t length = 0;
+    ghost_size_t i;
+    ghost_bool ok;
+    char* buffer;
+
+    /* Measure first so it can all go out in one write. */
+    for (i = 0; i < count; ++i)
+        length = mirror_list_test(ghost_null, length, tests[i], format);
+    if (length == 0)
+        return ghost_true;
+
+    buffer = ghost_static_cast(char*, ghost_calloc(length, 1));
+    if (buffer == ghost_null) {
+        fprintf(stderr, "Failed to allocate list of %" GHOST_PRIuZ " tests.\n", count);
+        return ghost_false;
+    }
+    for (i = 0, length = 0; i < count; ++i)
+        length = mirror_list_test(buffer, length, tests[i], format);
+
+    ok = (length == fwrite(buffer, 1, length, stdout));
+    if (0 != fflush(stdout))
+        ok = ghost_false;
+    ghost_free(buffer);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MIRROR_IMPL_INTERNAL_MPH_H
+#define MIRROR_IMPL_INTERNAL_MPH_H
+
+/*
+ * Minimal perfect hashing of 64-bit keys, and the string hash we use to make
+ * keys out of strings.
+ *
+ * Given n distinct keys this builds a function that maps each of them to a
+ * distinct slot in [0, n), taking two bytes per key. A lookup is two hashes
+ * and one array read. Keys that weren't in the set map to some arbitrary slot
+ * so the caller has to check what it finds there.
+ *
+ * This is the hash-and-displace scheme (as in CHD.) The keys are split into
+ * n/2 buckets by one hash. Buckets are then placed largest first: for each we
+ * search for a seed under which a second hash sends all of its keys to free
+ * slots, and store the seed. Buckets of a single key are placed last straight
+ * into the remaining free slots, storing the slot instead (as a negative
+ * number), so the end of the build doesn't turn into a hunt for the last few
+ * free slots.
+ *
+ * Building fails only if the keys aren't distinct.
+ */
+
+#include "mirror/impl/mirror_impl_ghost.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+
+/* A bucket that can't be placed by this seed must hold duplicate keys. */
+#define MIRROR_IMPL_MPH_MAX_SEED 0x10000
+
+typedef struct mirror_mph_t {
+    ghost_int32_t* seeds; /* of each bucket, or -slot-1 for a bucket of one key */
+    ghost_uint32_t buckets;
+    ghost_uint32_t count;
+} mirror_mph_t;
+
+typedef struct mirror_mph_bucket_t {
+    ghost_uint32_t index;
+    ghost_uint32_t size;
+    ghost_uint32_t first; /* in the keys sorted by bucket */
+} mirror_mph_bucket_t;
+
+/* 64-bit FNV-1a */
+static ghost_uint64_t mirror_mph_hash_string(ghost_uint64_t hash, const char* string) {
+    for (; *string != '\0'; ++string) {
+        hash ^= ghost_static_cast(unsigned char, *string);
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+static ghost_uint64_t mirror_mph_hash_uint(ghost_uint64_t hash, ghost_uint64_t value) {
+    int i;
+    for (i = 0; i < 8; ++i, value >>= 8) {
+        hash ^= value & 0xffu;
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+/* Returns the FNV-1a hash of the given string. */
+static ghost_uint64_t mirror_mph_hash(const char* string) {
+    return mirror_mph_hash_string(0xcbf29ce484222325u, string);
+}
+
+/* Mixes a key with a seed (the splitmix64 finalizer.) */
+static ghost_uint64_t mirror_mph_mix(ghost_uint64_t key, ghost_uint64_t seed) {
+    key ^= seed * 0x9e3779b97f4a7c15u;
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9u;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebu;
+    return key ^ (key >> 31);
+}
+
+static int mirror_mph_bucket_compare(const void* vleft, const void* vright) {
+    const mirror_mph_bucket_t* left = ghost_static_cast(const mirror_mph_bucket_t*, vleft);
+    const mirror_mph_bucket_t* right = ghost_static_cast(const mirror_mph_bucket_t*, vright);
+    if (left->size != right->size)
+        return (left->size > right->size) ? -1 : 1;
+    return (left->index < right->index) ? -1 : (left->index > right->index);
+}
+
+static void mirror_mph_init(mirror_mph_t* mph) {
+    mph->seeds = ghost_null;
+    mph->buckets = 0;
+    mph->count = 0;
+}
+
+static void mirror_mph_destroy(mirror_mph_t* mph) {
+    ghost_free(mph->seeds);
+    mirror_mph_init(mph);
+}
+
+/* Returns the slot of the given key. The mph must not be empty. */
+static ghost_uint32_t mirror_mph_lookup(const mirror_mph_t* mph, ghost_uint64_t key) {
+    ghost_int32_t seed = mph->seeds[mirror_mph_mix(key, 0) % mph->buckets];
+    if (seed < 0)
+        return ghost_static_cast(ghost_uint32_t, -(seed + 1));
+    return ghost_static_cast(ghost_uint32_t, mirror_mph_mix(key, ghost_static_cast(ghost_uint64_t, seed)) % mph->count);
+}
+
+/*
+ * Tries to place the keys of a bucket with the given seed, marking their
+ * slots as taken. If any slot is taken (or two keys want the same one)
+ * nothing is marked.
+ */
+static ghost_bool mirror_mph_place(const mirror_mph_t* mph, const ghost_uint64_t* keys,
+        const ghost_uint32_t* order, const mirror_mph_bucket_t* bucket,
+        ghost_uint64_t seed, unsigned char* taken)
+{
+    ghost_uint32_t i, j, slot;
+    for (i = 0; i < bucket->size; ++i) {
+        slot = ghost_static_cast(ghost_uint32_t,
+                mirror_mph_mix(keys[order[bucket->first + i]], seed) % mph->count);
+        if (taken[slot]) {
+            for (j = 0; j < i; ++j)
+                taken[mirror_mph_mix(keys[order[bucket->first + j]], seed) % mph->count] = 0;
+            return ghost_false;
+        }
+        taken[slot] = 1;
+    }
+    return ghost_true;
+}
+
+/*
+ * Builds a minimal perfect hash of the given keys. Returns false (leaving the
+ * mph empty) if the keys aren't distinct or there are more than 2^31 of them.
+ * Aborts if out of memory.
+ */
+static ghost_bool mirror_mph_build(mirror_mph_t* mph, const ghost_uint64_t* keys, ghost_uint32_t count) {
+    mirror_mph_bucket_t* buckets;
+    ghost_uint32_t* order;
+    unsigned char* taken;
+    ghost_uint32_t i, b, seed, free_slot;
+    ghost_bool placed = ghost_true;
+
+    mirror_mph_init(mph);
+    if (count == 0)
+        return ghost_true;
+    if (count > 0x7fffffffu)
+        return ghost_false;
+
+    mph->count = count;
+    mph->buckets = count / 2 + 1;
+    mph->seeds = ghost_static_cast(ghost_int32_t*, ghost_calloc(mph->buckets, sizeof(ghost_int32_t)));
+    buckets = ghost_static_cast(mirror_mph_bucket_t*, ghost_calloc(mph->buckets, sizeof(mirror_mph_bucket_t)));
+    order = ghost_static_cast(ghost_uint32_t*, ghost_calloc(count, sizeof(ghost_uint32_t)));
+    taken = ghost_static_cast(unsigned char*, ghost_calloc(count, 1));
+    if (mph->seeds == ghost_null || buckets == ghost_null || order == ghost_null || taken == ghost_null) {
+        fprintf(stderr, "Failed to allocate hash of %lu keys.\n", ghost_static_cast(unsigned long, count));
+        ghost_abort();
+    }
+
+    /* Sort the keys by bucket. */
+    for (i = 0; i < count; ++i)
+        ++buckets[mirror_mph_mix(keys[i], 0) % mph->buckets].size;
+    for (b = 0, i = 0; b < mph->buckets; ++b) {
+        buckets[b].index = b;
+        buckets[b].first = i;
+        i += buckets[b].size;
+        buckets[b].size = 0;
+    }
+    for (i = 0; i < count; ++i) {
+        b = ghost_static_cast(ghost_uint32_t, mirror_mph_mix(keys[i], 0) % mph->buckets);
+        order[buckets[b].first + buckets[b].size++] = i;
+    }
+
+    qsort(buckets, mph->buckets, sizeof(mirror_mph_bucket_t), mirror_mph_bucket_compare);
+
+    /* Place the big buckets by searching for seeds. */
+    for (b = 0; b < mph->buckets && buckets[b].size > 1; ++b) {
+        for (seed = 1; seed < MIRROR_IMPL_MPH_MAX_SEED; ++seed)
+            if (mirror_mph_place(mph, keys, order, &buckets[b], seed, taken))
+                break;
+        if (seed == MIRROR_IMPL_MPH_MAX_SEED) {
+            placed = ghost_false;
+            break;
+        }
+        mph->seeds[buckets[b].index] = ghost_static_cast(ghost_int32_t, seed);
+    }
+
+    /* Put the single keys in whatever slots are left. */
+    for (free_slot = 0; placed && b < mph->buckets && buckets[b].size == 1; ++b) {
+        while (taken[free_slot])
+            ++free_slot;
+        taken[free_slot] = 1;
+        mph->seeds[buckets[b].index] = -ghost_static_cast(ghost_int32_t, free_slot) - 1;
+    }
+
+    ghost_free(taken);
+    ghost_free(order);
+    ghost_free(buckets);
+    if (!placed)
+        mirror_mph_destroy(mph);
+    return placed;
+}
+
+#endif
@@ -0,0 +1,371 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_OPTIONS_H
+#define MIRROR_IMPL_INTERNAL_OPTIONS_H
+
+/*
+ * Command-line options of the internal runner.
+ */
+
+#include "mirror/impl/mirror_impl_internal_platform.h"
+#include "mirror/impl/mirror_impl_internal_time.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+typedef enum mirror_shard_by_t {
+    mirror_shard_by_hash,
+    mirror_shard_by_range,
+    mirror_shard_by_duration
+} mirror_shard_by_t;
+
+typedef enum mirror_list_format_t {
+    mirror_list_format_none, /* run tests rather than list them */
+    mirror_list_format_plain,
+    mirror_list_format_null
+} mirror_list_format_t;
+
+typedef struct mirror_options_t {
+    ghost_size_t jobs; /* number of workers. 1 runs tests on the main thread. */
+    ghost_bool fork;   /* run tests in worker processes rather than threads */
+    const char* /*nullable*/ history; /* result history file, or null for the default */
+    ghost_bool no_history;
+    ghost_size_t shard_index;
+    ghost_size_t shard_count; /* 1 if not sharding */
+    mirror_shard_by_t shard_by;
+    ghost_size_t slowest; /* number of slowest tests to report, or 0 */
+    unsigned long timeout; /* default test timeout in milliseconds, or 0 */
+    ghost_bool fail_fast; /* stop at the first failing test */
+    ghost_size_t seed;    /* of property tests */
+    ghost_bool seeded;    /* false to pick a new seed */
+    ghost_bool smoke;     /* run only smoke tests */
+    ghost_bool only_failed; /* run only tests that failed in the previous run */
+    const char* /*nullable*/ filter; /* GoogleTest-style name filter */
+    const char* /*nullable*/ filter_regex;
+    mirror_list_format_t list;
+} mirror_options_t;
+
+static void mirror_options_usage(FILE* file, const char* program) {
+    fprintf(file,
+            "Usage: %s [options]\n"
+            "\n"
+            "Options:\n"
+            "    -j N, --jobs=N      Run tests on N worker threads. With no N, use one\n"
+            "                        worker per online CPU.\n"
+            "    --fork              Run tests in worker processes (as many as -j) so\n"
+            "                        that a crashing test can't take down the run.\n"
+            "    --history=FILE      Load and save test results in FILE. The default is\n"
+            "                        the program name followed by .mirror-history.\n"
+            "    --no-history        Don't load or save test results.\n"
+            "    --only-failed       Run only the tests that failed in the previous run\n"
+            "                        according to the history.\n"
+            "    --shard-index=I     Run only shard I (from 0) of the tests. The default\n"
+            "                        is $GTEST_SHARD_INDEX.\n"
+            "    --shard-count=N     Split the tests into N shards. The default is\n"
+            "                        $GTEST_TOTAL_SHARDS.\n"
+            "    --shard-by=MODE     Split by hash of the test id (the default), by\n"
+            "                        range of the registry, or by duration according\n"
+            "                        to the history.\n"
+            "    --slowest[=N]       Report the N slowest tests (default 10) with their\n"
+            "                        wall and CPU time.\n"
+            "    --timeout=MS        Fail tests that run longer than MS milliseconds\n"
+            "                        unless they set their own timeout. Without\n"
+            "                        --fork a timeout ends the run.\n"
+            "    --fail-fast         Stop the run at the first failing test.\n"
+            "    --seed=N            Seed the random inputs of property tests with N.\n"
+            "                        The default is a new seed each run, reported when\n"
+            "                        a property fails.\n"
+            "    --smoke             Run only the tests marked smoke.\n"
+            "    --filter=PATTERNS   Run only the tests whose names match one of the\n"
+            "                        colon-separated globs in PATTERNS and none of\n"
+            "                        those after a '-', e.g. 'net/*:io/*-*/slow'. The\n"
+            "                        default is $GTEST_FILTER.\n"
+            "    --filter-regex=RE   Run only the tests whose names match the POSIX\n"
+            "                        extended regular expression RE.\n"
+            "    --list-tests[=FMT]  List the tests that pass the filter without running\n"
+            "                        anything. Each test's id, name, file, line, flags\n"
+            "                        and description are separated by tabs (FMT plain,\n"
+            "                        the default) or each end with a NUL (FMT null).\n"
+            "    -h, --help          Show this help.\n",
+            program);
+}
+
+static void mirror_options_fail(const char* program, const char* message, const char* arg) {
+    fprintf(stderr, "%s: %s: %s\n", program, message, arg);
+    mirror_options_usage(stderr, program);
+    exit(EXIT_FAILURE);
+}
+
+/* Parses a non-negative decimal number. Fails if it doesn't fit. */
+static ghost_bool mirror_options_parse_index(const char* arg, ghost_size_t* out) {
+    ghost_size_t value = 0;
+    ghost_size_t digit;
+    if (*arg == '\0')
+        return ghost_false;
+    for (; *arg != '\0'; ++arg) {
+        if (*arg < '0' || *arg > '9')
+            return ghost_false;
+        digit = ghost_static_cast(ghost_size_t, *arg - '0');
+        if (value > (ghost_static_cast(ghost_size_t, -1) - digit) / 10)
+            return ghost_false;
+        value = value * 10 + digit;
+    }
+    *out = value;
+    return ghost_true;
+}
+
+/* Parses a positive decimal number. */
+static ghost_bool mirror_options_parse_count(const char* arg, ghost_size_t* out) {
+    ghost_size_t value;
+    if (!mirror_options_parse_index(arg, &value) || value == 0)
+        return ghost_false;
+    *out = value;
+    return ghost_true;
+}
+
+static ghost_size_t mirror_options_cpu_count(void) {
+    #if MIRROR_POSIX && defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > 0)
+        return ghost_static_cast(ghost_size_t, count);
+    #endif
+    return 1;
+}
+
+/*
+ * Returns the value of a "--name=value" or "--name value" option, or null if
+ * arg is not the named option.
+ */
+static const char* mirror_options_value(const char* name, int argc, char** argv, int* i) {
+    const char* arg = argv[*i];
+    ghost_size_t length = strlen(name);
+    if (0 != strncmp(arg, name, length))
+        return ghost_null;
+    if (arg[length] == '=')
+        return arg + length + 1;
+    if (arg[length] != '\0')
+        return ghost_null;
+    if (*i + 1 >= argc)
+        mirror_options_fail(argv[0], "missing value for option", arg);
+    return argv[++*i];
+}
+
+static void mirror_options_parse(mirror_options_t* options, int argc, char** argv) {
+    const char* program = (argc > 0) ? argv[0] : "mirror";
+    const char* value;
+    int i;
+
+    options->jobs = 1;
+    options->fork = ghost_false;
+    options->history = ghost_null;
+    options->no_history = ghost_false;
+    options->shard_index = 0;
+    options->shard_count = 1;
+    options->shard_by = mirror_shard_by_hash;
+    options->slowest = 0;
+    options->timeout = 0;
+    options->fail_fast = ghost_false;
+    options->seed = 0;
+    options->seeded = ghost_false;
+    options->smoke = ghost_false;
+    options->only_failed = ghost_false;
+    options->filter = ghost_null;
+    options->filter_regex = ghost_null;
+    options->list = mirror_list_format_none;
+
+    /* The command line overrides the environment. */
+    value = getenv("GTEST_SHARD_INDEX");
+    if (value != ghost_null && *value != '\0' && !mirror_options_parse_index(value, &options->shard_index))
+        mirror_options_fail(program, "invalid GTEST_SHARD_INDEX", value);
+    value = getenv("GTEST_TOTAL_SHARDS");
+    if (value != ghost_null && *value != '\0' && !mirror_options_parse_count(value, &options->shard_count))
+        mirror_options_fail(program, "invalid GTEST_TOTAL_SHARDS", value);
+    value = getenv("GTEST_FILTER");
+    if (value != ghost_null && *value != '\0')
+        options->filter = value;
+
+    for (i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+
+        if (0 == strcmp(arg, "-h") || 0 == strcmp(arg, "--help")) {
+            mirror_options_usage(stdout, program);
+            exit(EXIT_SUCCESS);
+        }
+
+        /* -j, -jN, -j N */
+        if (0 == strncmp(arg, "-j", 2)) {
+            if (arg[2] != '\0') {
+                value = arg + 2;
+            } else if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                value = argv[++i];
+            } else {
+                options->jobs = mirror_options_cpu_count();
+                continue;
+            }
+            if (!mirror_options_parse_count(value, &options->jobs))
+                mirror_options_fail(program, "invalid job count", value);
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--fork")) {
+            options->fork = ghost_true;
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--fail-fast")) {
+            options->fail_fast = ghost_true;
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--smoke")) {
+            options->smoke = ghost_true;
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--list-tests")) {
+            options->list = mirror_list_format_plain;
+            continue;
+        }
+
+        if (0 == strncmp(arg, "--list-tests=", 13)) {
+            if (0 == strcmp(arg + 13, "plain"))
+                options->list = mirror_list_format_plain;
+            else if (0 == strcmp(arg + 13, "null"))
+                options->list = mirror_list_format_null;
+            else
+                mirror_options_fail(program, "invalid list format", arg + 13);
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--only-failed")) {
+            options->only_failed = ghost_true;
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--no-history")) {
+            options->no_history = ghost_true;
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--history", argc, argv, &i))) {
+            options->history = value;
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--filter", argc, argv, &i))) {
+            options->filter = value;
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--filter-regex", argc, argv, &i))) {
+            options->filter_regex = value;
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--shard-index", argc, argv, &i))) {
+            if (!mirror_options_parse_index(value, &options->shard_index))
+                mirror_options_fail(program, "invalid shard index", value);
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--shard-count", argc, argv, &i))) {
+            if (!mirror_options_parse_count(value, &options->shard_count))
+                mirror_options_fail(program, "invalid shard count", value);
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--shard-by", argc, argv, &i))) {
+            if (0 == strcmp(value, "hash"))
+                options->shard_by = mirror_shard_by_hash;
+            else if (0 == strcmp(value, "range"))
+                options->shard_by = mirror_shard_by_range;
+            else if (0 == strcmp(value, "duration"))
+                options->shard_by = mirror_shard_by_duration;
+            else
+                mirror_options_fail(program, "invalid shard mode", value);
+            continue;
+        }
+
+        if (0 == strcmp(arg, "--slowest")) {
+            options->slowest = 10;
+            continue;
+        }
+
+        if (0 == strncmp(arg, "--slowest=", 10)) {
+            if (!mirror_options_parse_count(arg + 10, &options->slowest))
+                mirror_options_fail(program, "invalid count", arg + 10);
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--timeout", argc, argv, &i))) {
+            ghost_size_t timeout;
+            if (!mirror_options_parse_index(value, &timeout) ||
+                    ghost_static_cast(ghost_uint64_t, timeout) > MIRROR_IMPL_TIMEOUT_MAX ||
+                    ghost_static_cast(ghost_size_t, ghost_static_cast(unsigned long, timeout)) != timeout)
+                mirror_options_fail(program, "invalid timeout", value);
+            options->timeout = ghost_static_cast(unsigned long, timeout);
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--seed", argc, argv, &i))) {
+            if (!mirror_options_parse_index(value, &options->seed))
+                mirror_options_fail(program, "invalid seed", value);
+            options->seeded = ghost_true;
+            continue;
+        }
+
+        if (ghost_null != (value = mirror_options_value("--jobs", argc, argv, &i))) {
+            if (!mirror_options_parse_count(value, &options->jobs))
+                mirror_options_fail(program, "invalid job count", value);
+            continue;
+        }
+
+        mirror_options_fail(program, "unrecognized option", arg);
+    }
+
+    if (options->shard_index >= options->shard_count) {
+        fprintf(stderr, "%s: shard index %" GHOST_PRIuZ " is out of range for %" GHOST_PRIuZ " shards.\n",
+                program, options->shard_index, options->shard_count);
+        exit(EXIT_FAILURE);
+    }
+
+    #if !MIRROR_FORK
+    if (options->fork) {
+        fprintf(stderr, "%s: this build of mirror does not support --fork. Running in-process.\n", program);
+        options->fork = ghost_false;
+    }
+    #endif
+
+    #if !MIRROR_THREADS
+    if (options->jobs > 1 && !options->fork) {
+        fprintf(stderr, "%s: this build of mirror does not support threads. Running serially.\n", program);
+        options->jobs = 1;
+    }
+    #endif
+}
+
+#endif
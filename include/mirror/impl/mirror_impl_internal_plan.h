@@ -0,0 +1,285 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_PLAN_H
+#define MIRROR_IMPL_INTERNAL_PLAN_H
+
+/*
+ * Planning which tests to run and in what order.
+ *
+ * Tests with the skip option are dropped from the run, as are tests without
+ * the smoke option under --smoke and tests that didn't fail last time under
+ * --only-failed. None of these cost anything beyond this.
+ *
+ * The remaining tests are ordered by their rank in the history: tests that
+ * failed last time first, then new or changed tests, then the rest, so that a
+ * regression shows up as early as possible.
+ *
+ * The deps() of the remaining tests form a graph. Each test records how many
+ * of its dependencies are still waiting to finish along with the tests that
+ * depend on it. The plan is put in dependency order so that a serial run can
+ * just go down the list. A test runs only once all of its dependencies have
+ * passed. As soon as one of them doesn't pass the test and everything that
+ * depends on it is blocked, so a broken test is reported once rather than
+ * along with every test downstream of it.
+ *
+ * A dependency that exists but isn't part of this run (because it's skipped,
+ * it isn't a smoke test or it's in another shard) is assumed to pass. A
+ * dependency that doesn't exist or a cycle of dependencies fails the tests
+ * involved without running them.
+ */
+
+#include "mirror/impl/mirror_impl_internal_history.h"
+#include "mirror/impl/mirror_impl_internal_options.h"
+#include "mirror/impl/mirror_impl_internal_registry.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+typedef struct mirror_plan_t {
+    mirror_test_t** edges; /* storage for the dependents of all tests */
+    ghost_size_t skipped;  /* tests dropped for the skip option */
+    ghost_bool graph;      /* whether any test in the plan depends on another */
+} mirror_plan_t;
+
+/*
+ * Calls the given function for each planned test with the given name. Returns
+ * false if no test at all has that name.
+ */
+static ghost_bool mirror_plan_each_named(const char* name, mirror_test_t* dependent,
+        void (*fn)(mirror_test_t* dependency, mirror_test_t* dependent))
+{
+    ghost_uint32_t handle = mirror_registry_find_name(name);
+    ghost_uint32_t name_id;
+    mirror_test_t* test;
+
+    if (handle == MIRROR_REGISTRY_NONE)
+        return ghost_false;
+
+    /* Tests with the same name follow the first in the registry. */
+    name_id = mirror_impl_registry_tests[handle]->name_id;
+    for (; handle < mirror_impl_registry_count; ++handle) {
+        test = mirror_impl_registry_tests[handle];
+        if (test->name_id != name_id)
+            break;
+        if (test->planned)
+            fn(test, dependent);
+    }
+    return ghost_true;
+}
+
+static void mirror_plan_count_edge(mirror_test_t* dependency, mirror_test_t* dependent) {
+    (void)dependent;
+    ++dependency->dependents_count;
+}
+
+static void mirror_plan_add_edge(mirror_test_t* dependency, mirror_test_t* dependent) {
+    dependency->dependents[dependency->dependents_count++] = dependent;
+    ++dependent->waiting;
+}
+
+/* Blocks everything that depends on the given test. Returns how many. */
+static ghost_size_t mirror_plan_prune(mirror_test_t* test) {
+    ghost_size_t pruned = 0;
+    ghost_size_t i;
+    for (i = 0; i < test->dependents_count; ++i) {
+        mirror_test_t* dependent = test->dependents[i];
+        if (dependent->status != mirror_status_none)
+            continue;
+        dependent->status = mirror_status_blocked;
+        pruned += 1 + mirror_plan_prune(dependent);
+    }
+    return pruned;
+}
+
+/* Stably sorts the given tests by their rank in the history. */
+static void mirror_plan_rank(mirror_test_t** tests, ghost_size_t count) {
+    mirror_test_t** sorted;
+    ghost_size_t i, n = 0;
+    int rank;
+
+    for (i = 1; i < count; ++i)
+        if (mirror_history_rank(tests[i]) != mirror_history_rank(tests[0]))
+            break;
+    if (i >= count)
+        return;
+
+    sorted = ghost_static_cast(mirror_test_t**, ghost_calloc(count, sizeof(mirror_test_t*)));
+    if (sorted == ghost_null)
+        return; /* the order is only a hint */
+    for (rank = 0; rank <= 2; ++rank)
+        for (i = 0; i < count; ++i)
+            if (mirror_history_rank(tests[i]) == rank)
+                sorted[n++] = tests[i];
+    memcpy(tests, sorted, count * sizeof(mirror_test_t*));
+    ghost_free(sorted);
+}
+
+/*
+ * Drops skipped (and under --smoke or --only-failed, unwanted) tests from the
+ * given tests, ranks the rest by their history, links them by their
+ * dependencies and sorts them in dependency order.
+ * Tests that can't run because of a missing dependency or a cycle are left at
+ * the end of the list having already failed.
+ */
+static void mirror_plan_init(mirror_plan_t* plan, const mirror_options_t* options,
+        mirror_test_t** tests, ghost_size_t* count)
+{
+    mirror_test_t** order;
+    mirror_test_t* test;
+    ghost_size_t edges = 0;
+    ghost_size_t i, j, n = 0, head, tail;
+
+    plan->edges = ghost_null;
+    plan->skipped = 0;
+    plan->graph = ghost_false;
+
+    for (i = 0; i < *count; ++i) {
+        test = tests[i];
+        if (test->skip) {
+            test->status = mirror_status_skip;
+            ++plan->skipped;
+            continue;
+        }
+        if (options->smoke && !test->smoke)
+            continue;
+        if (options->only_failed && !mirror_history_failed(test->previous))
+            continue;
+        test->planned = ghost_true;
+        tests[n++] = test;
+    }
+    *count = n;
+    mirror_plan_rank(tests, n);
+
+    /* Count the edges first so they can share one allocation. */
+    for (i = 0; i < n; ++i) {
+        test = tests[i];
+        for (j = 0; j < test->deps_count; ++j) {
+            if (!mirror_plan_each_named(test->deps[j], test, mirror_plan_count_edge)) {
+                test->status = mirror_status_fail;
+                printf("Test \"%s\" (%s:%i) depends on \"%s\" which doesn't exist.\n",
+                        test->name, test->file, test->line, test->deps[j]);
+            }
+        }
+    }
+    for (i = 0; i < n; ++i)
+        edges += tests[i]->dependents_count;
+    if (edges == 0)
+        return;
+
+    plan->graph = ghost_true;
+    plan->edges = ghost_static_cast(mirror_test_t**, ghost_calloc(edges, sizeof(mirror_test_t*)));
+    order = ghost_static_cast(mirror_test_t**, ghost_calloc(n, sizeof(mirror_test_t*)));
+    if (plan->edges == ghost_null || order == ghost_null) {
+        fprintf(stderr, "Failed to allocate dependencies of %" GHOST_PRIuZ " tests.\n", n);
+        ghost_abort();
+    }
+    for (i = 0, edges = 0; i < n; ++i) {
+        tests[i]->dependents = plan->edges + edges;
+        edges += tests[i]->dependents_count;
+        tests[i]->dependents_count = 0;
+    }
+    for (i = 0; i < n; ++i)
+        for (j = 0; j < tests[i]->deps_count; ++j)
+            mirror_plan_each_named(tests[i]->deps[j], tests[i], mirror_plan_add_edge);
+
+    /* Tests with a missing dependency block their own dependents. */
+    for (i = 0; i < n; ++i)
+        if (tests[i]->status == mirror_status_fail)
+            mirror_plan_prune(tests[i]);
+
+    /* Sort topologically (Kahn's algorithm), starting from the tests that
+     * wait on nothing in ranked order. The waiting counts are consumed by
+     * the sort so we count them again afterwards. */
+    head = tail = 0;
+    for (i = 0; i < n; ++i)
+        if (tests[i]->waiting == 0 && tests[i]->status == mirror_status_none)
+            order[tail++] = tests[i];
+    while (head < tail) {
+        test = order[head++];
+        for (j = 0; j < test->dependents_count; ++j)
+            if (--test->dependents[j]->waiting == 0 && test->dependents[j]->status == mirror_status_none)
+                order[tail++] = test->dependents[j];
+    }
+
+    /* Anything left over never became ready. */
+    for (i = 0; i < n; ++i) {
+        test = tests[i];
+        if (test->waiting != 0 && test->status == mirror_status_none) {
+            test->status = mirror_status_fail;
+            printf("Test \"%s\" (%s:%i) is in or depends on a cycle of dependencies.\n",
+                    test->name, test->file, test->line);
+        }
+        if (test->status != mirror_status_none)
+            order[tail++] = test;
+    }
+    fflush(stdout);
+
+    for (i = 0; i < n; ++i)
+        tests[i]->waiting = 0;
+    for (i = 0; i < n; ++i)
+        for (j = 0; j < tests[i]->dependents_count; ++j)
+            ++tests[i]->dependents[j]->waiting;
+
+    memcpy(tests, order, n * sizeof(mirror_test_t*));
+    ghost_free(order);
+}
+
+/*
+ * Records that the given test has finished. The dependents that are now ready
+ * to run are written to released (if not null) and their number returned. If
+ * the test didn't pass its dependents are blocked instead and their number is
+ * added to pruned.
+ *
+ * This is not thread-safe. The scheduler calls it under its lock.
+ */
+static ghost_size_t mirror_plan_done(mirror_test_t* test,
+        mirror_test_t** /*nullable*/ released, ghost_size_t* pruned)
+{
+    ghost_size_t count = 0;
+    ghost_size_t i;
+
+    if (test->status != mirror_status_pass) {
+        *pruned += mirror_plan_prune(test);
+        return 0;
+    }
+
+    for (i = 0; i < test->dependents_count; ++i) {
+        mirror_test_t* dependent = test->dependents[i];
+        if (--dependent->waiting == 0 && dependent->status == mirror_status_none) {
+            if (released != ghost_null)
+                released[count] = dependent;
+            ++count;
+        }
+    }
+    return count;
+}
+
+static void mirror_plan_destroy(mirror_plan_t* plan) {
+    ghost_free(plan->edges);
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_PLATFORM_H
+#define MIRROR_IMPL_INTERNAL_PLATFORM_H
+
+/*
+ * Platform detection for the internal runner.
+ *
+ * Everything the internal runner does beyond running tests serially is
+ * optional. Each feature can be forced off (or on) by defining its macro to 0
+ * (or 1) before including the runner.
+ */
+
+#include "mirror/impl/mirror_impl_ghost.h"
+
+/* TODO Ghost should detect this for us */
+#ifndef MIRROR_POSIX
+    #if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+        #define MIRROR_POSIX 1
+    #else
+        #define MIRROR_POSIX 0
+    #endif
+#endif
+
+#if MIRROR_POSIX
+    #include <unistd.h>
+#endif
+
+/* Thread-local storage, needed to find the current worker from a failing check. */
+#ifndef MIRROR_IMPL_THREAD_LOCAL
+    #if defined(__cplusplus) && __cplusplus >= 201103L
+        #define MIRROR_IMPL_THREAD_LOCAL thread_local
+    #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+        #define MIRROR_IMPL_THREAD_LOCAL _Thread_local
+    #elif GHOST_GCC || defined(__clang__)
+        #define MIRROR_IMPL_THREAD_LOCAL __thread
+    #endif
+#endif
+
+/* Running tests on a pool of threads (-j) */
+#ifndef MIRROR_THREADS
+    #if MIRROR_POSIX && defined(MIRROR_IMPL_THREAD_LOCAL)
+        #define MIRROR_THREADS 1
+    #else
+        #define MIRROR_THREADS 0
+    #endif
+#endif
+
+/* Running tests in a pool of worker processes (--fork) */
+#ifndef MIRROR_FORK
+    #define MIRROR_FORK MIRROR_POSIX
+#endif
+
+#if MIRROR_FORK
+    #include <errno.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <sys/resource.h>
+    #include <sys/types.h>
+    #include <sys/wait.h>
+#endif
+
+/*
+ * How a failed check unwinds its test. C++ throws so that destructors run;
+ * otherwise we longjmp() back to the runner.
+ */
+#ifndef MIRROR_EXCEPTIONS
+    #if defined(__cplusplus) && (defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND))
+        #define MIRROR_EXCEPTIONS 1
+    #else
+        #define MIRROR_EXCEPTIONS 0
+    #endif
+#endif
+
+#if !MIRROR_EXCEPTIONS
+    #include <setjmp.h>
+#endif
+
+#if MIRROR_THREADS
+    #include <pthread.h>
+#else
+    #undef MIRROR_IMPL_THREAD_LOCAL
+    #define MIRROR_IMPL_THREAD_LOCAL /*nothing*/
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_POOL_H
+#define MIRROR_IMPL_INTERNAL_POOL_H
+
+/*
+ * The internal runner's thread pool.
+ *
+ * Each worker thread takes tests from the scheduler with its own worker state
+ * so fixtures and failures are tracked per thread.
+ */
+
+#include "mirror/impl/mirror_impl_internal_sched.h"
+#include "mirror/impl/mirror_impl_internal_watchdog.h"
+
+#if MIRROR_THREADS
+
+typedef struct mirror_pool_thread_t {
+    mirror_worker_t worker;
+    mirror_sched_t* sched;
+} mirror_pool_thread_t;
+
+static void* mirror_pool_thread(void* vthread) {
+    mirror_pool_thread_t* thread = ghost_static_cast(mirror_pool_thread_t*, vthread);
+    mirror_test_t* test;
+    for (;;) {
+        test = mirror_sched_take(thread->sched, thread->worker.index);
+        if (test == ghost_null) {
+            if (mirror_sched_wait(thread->sched))
+                continue;
+            break;
+        }
+        mirror_run(&thread->worker, test);
+        mirror_sched_done(thread->sched, test);
+    }
+    mirror_worker_finish(&thread->worker);
+    return ghost_null;
+}
+
+/*
+ * Runs the scheduled tests on one worker thread per deque, returning once all
+ * of them have run.
+ */
+static void mirror_pool_run(mirror_sched_t* sched) {
+    mirror_pool_thread_t* threads;
+    ghost_size_t jobs = sched->workers;
+    ghost_size_t i;
+
+    threads = ghost_static_cast(mirror_pool_thread_t*, ghost_calloc(jobs, sizeof(mirror_pool_thread_t)));
+    if (threads == ghost_null) {
+        fprintf(stderr, "Failed to allocate %" GHOST_PRIuZ " workers.\n", jobs);
+        ghost_abort();
+    }
+
+    for (i = 0; i < jobs; ++i) {
+        threads[i].worker.index = i;
+        threads[i].sched = sched;
+        mirror_watchdog_watch(&threads[i].worker);
+        if (0 != pthread_create(&threads[i].worker.thread, ghost_null, mirror_pool_thread, &threads[i])) {
+            fprintf(stderr, "Failed to start worker thread %" GHOST_PRIuZ ".\n", i);
+            ghost_abort();
+        }
+    }
+    for (i = 0; i < jobs; ++i)
+        pthread_join(threads[i].worker.thread, ghost_null);
+
+    mirror_watchdog_unwatch_all();
+    ghost_free(threads);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef MIRROR_IMPL_INTERNAL_REGISTRY_H
+#define MIRROR_IMPL_INTERNAL_REGISTRY_H
+
+/*
+ * The registry of the current run.
+ *
+ * Once all tests are registered the runner lays them out in a dense array in
+ * name order. A test's handle is its index in this array. Handles are what
+ * the runner sends to its worker processes and fork servers (which inherit
+ * the registry) instead of pointers, so a request is four bytes.
+ *
+ * All strings of all tests are interned into one contiguous string table and
+ * the tests are pointed into it. Each distinct string is stored once, so two
+ * tests have the same name (or file) exactly when they have the same name_id
+ * (or file_id), and comparing them is an integer compare.
+ *
+ * The registry also builds two minimal perfect hashes: one of the distinct
+ * names, to find the tests with a given name (for dependencies and exact
+ * filter patterns), and one of the tests' keys (see mirror_registry_key()), to
+ * find a test's record in the history. Either lookup is constant time. With
+ * tens of thousands of tests and dense dependency lists this beats a tree
+ * lookup with string compares for every dependency. If a hash can't be built
+ * (because two distinct names hash alike, or two tests have the same key) the
+ * name lookup falls back to the test tree and the history to a binary search.
+ */
+
+#include "mirror/impl/mirror_impl_runner_common.h"
+#include "mirror/impl/mirror_impl_internal_mph.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+/* Not a handle or string id. */
+#define MIRROR_REGISTRY_NONE 0xffffffffu
+
+typedef struct mirror_registry_slot_t {
+    const char* string; /* or null if the slot is empty */
+    ghost_uint64_t hash;
+    ghost_uint32_t id; /* offset in the string table */
+} mirror_registry_slot_t;
+
+/* The open-addressed hash table used to intern strings while building. */
+typedef struct mirror_registry_interner_t {
+    mirror_registry_slot_t* slots;
+    ghost_size_t mask;
+    ghost_size_t size; /* of the string table so far */
+} mirror_registry_interner_t;
+
+static mirror_test_t** mirror_impl_registry_tests;
+static ghost_uint32_t mirror_impl_registry_count;
+static char* mirror_impl_registry_strings;
+
+/* The first test with each name, by the slot of the name's hash */
+static mirror_mph_t mirror_impl_registry_names;
+static ghost_uint32_t* mirror_impl_registry_named;
+
+/* Each test by the slot of its key */
+static mirror_mph_t mirror_impl_registry_keys;
+static ghost_uint32_t* mirror_impl_registry_keyed;
+
+/* Returns the test with the given handle, or null if there isn't one. */
+ghost_maybe_unused
+static mirror_test_t* mirror_registry_test(ghost_uint32_t handle) {
+    if (handle >= mirror_impl_registry_count)
+        return ghost_null;
+    return mirror_impl_registry_tests[handle];
+}
+
+/*
+ * Returns the key of the test: a hash of its file and name, or of its file
+ * and id if it wasn't given a name. A default id comes from a counter so it
+ * shifts whenever a test is added above it; a name doesn't.
+ */
+static ghost_uint64_t mirror_registry_key(const mirror_test_t* test) {
+    ghost_uint64_t hash = mirror_mph_hash(test->file);
+    if (test->named) {
+        hash = mirror_mph_hash_string(hash, "\n");
+        return mirror_mph_hash_string(hash, test->name);
+    }
+    hash = mirror_mph_hash_string(hash, ":");
+    return mirror_mph_hash_string(hash, test->id);
+}
+
+/*
+ * Returns the handle of the first test with the given name, or
+ * MIRROR_REGISTRY_NONE if there isn't one. Tests with the same name follow
+ * it in the registry.
+ */
+static ghost_uint32_t mirror_registry_find_name(const char* name) {
+    mirror_strkey_t key;
+    mirror_test_t* test;
+    ghost_uint32_t handle;
+
+    if (mirror_impl_registry_named != ghost_null) {
+        handle = mirror_impl_registry_named[mirror_mph_lookup(&mirror_impl_registry_names,
+                mirror_mph_hash(name))];
+        return (0 == strcmp(mirror_impl_registry_tests[handle]->name, name)) ?
+                handle : MIRROR_REGISTRY_NONE;
+    }
+
+    if (mirror_impl_registry_count == 0)
+        return MIRROR_REGISTRY_NONE;
+    mirror_strkey_init(&key, name);
+    test = mirror_all_tests_find_first(mirror_all_tests(), &key);
+    return (test == ghost_null) ? MIRROR_REGISTRY_NONE : test->handle;
+}
+
+/*
+ * Returns the handle of the test with the given key, or MIRROR_REGISTRY_NONE
+ * if there's no such test or the keys couldn't be hashed (see
+ * mirror_registry_keyed().)
+ */
+static ghost_uint32_t mirror_registry_find_key(ghost_uint64_t key) {
+    ghost_uint32_t handle;
+    if (mirror_impl_registry_keyed == ghost_null)
+        return MIRROR_REGISTRY_NONE;
+    handle = mirror_impl_registry_keyed[mirror_mph_lookup(&mirror_impl_registry_keys, key)];
+    return (mirror_impl_registry_tests[handle]->key == key) ? handle : MIRROR_REGISTRY_NONE;
+}
+
+/* Returns true if tests can be found by key. */
+static ghost_bool mirror_registry_keyed(void) {
+    return mirror_impl_registry_keyed != ghost_null;
+}
+
+/* Returns the slot of the given string, which is empty if it isn't interned. */
+static mirror_registry_slot_t* mirror_registry_slot(mirror_registry_interner_t* interner,
+        const char* string, ghost_uint64_t hash)
+{
+    ghost_size_t i = ghost_static_cast(ghost_size_t, hash) & interner->mask;
+    mirror_registry_slot_t* slot;
+    for (;; i = (i + 1) & interner->mask) {
+        slot = &interner->slots[i];
+        if (slot->string == ghost_null ||
+                (slot->hash == hash && (slot->string == string || 0 == strcmp(slot->string, string))))
+            return slot;
+    }
+}
+
+/*
+ * Interns the given string, returning its offset in the string table (which
+ * doesn't exist yet.)
+ */
+static ghost_uint32_t mirror_registry_intern(mirror_registry_interner_t* interner, const char* string) {
+    ghost_uint64_t hash = mirror_mph_hash(string);
+    mirror_registry_slot_t* slot = mirror_registry_slot(interner, string, hash);
+    ghost_size_t length;
+
+    if (slot->string != ghost_null)
+        return slot->id;
+
+    length = strlen(string) + 1;
+    if (interner->size + length >= MIRROR_REGISTRY_NONE) {
+        fprintf(stderr, "The strings of all tests don't fit in a 32-bit string table.\n");
+        ghost_abort();
+    }
+    slot->string = string;
+    slot->hash = hash;
+    slot->id = ghost_static_cast(ghost_uint32_t, interner->size);
+    interner->size += length;
+    return slot->id;
+}
+
+/*
+ * Builds a perfect hash of the given keys and a table of the given handles by
+ * slot. Returns the table, or null if the keys aren't distinct.
+ */
+static ghost_uint32_t* mirror_registry_hash(mirror_mph_t* mph, const ghost_uint64_t* keys,
+        const ghost_uint32_t* handles, ghost_uint32_t count)
+{
+    ghost_uint32_t* table;
+    ghost_uint32_t i;
+
+    if (count == 0 || !mirror_mph_build(mph, keys, count))
+        return ghost_null;
+    table = ghost_static_cast(ghost_uint32_t*, ghost_calloc(count, sizeof(ghost_uint32_t)));
+    if (table == ghost_null) {
+        fprintf(stderr, "Failed to allocate hash of %lu tests.\n", ghost_static_cast(unsigned long, count));
+        ghost_abort();
+    }
+    for (i = 0; i < count; ++i)
+        table[mirror_mph_lookup(mph, keys[i])] = handles[i];
+    return table;
+}
+
+/* Builds the hashes of names and keys. */
+static void mirror_registry_init_hashes(void) {
+    ghost_uint32_t count = mirror_impl_registry_count;
+    ghost_uint32_t names = 0;
+    ghost_uint64_t* keys;
+    ghost_uint32_t* handles;
+    ghost_uint32_t i;
+
+    keys = ghost_static_cast(ghost_uint64_t*, ghost_calloc(count + 1, sizeof(ghost_uint64_t)));
+    handles = ghost_static_cast(ghost_uint32_t*, ghost_calloc(count + 1, sizeof(ghost_uint32_t)));
+    if (keys == ghost_null || handles == ghost_null) {
+        fprintf(stderr, "Failed to allocate hashes of %lu tests.\n", ghost_static_cast(unsigned long, count));
+        ghost_abort();
+    }
+
+    /* Tests with the same name are adjacent so the first of each run is the
+     * first with its name. */
+    for (i = 0; i < count; ++i) {
+        if (i == 0 || mirror_impl_registry_tests[i - 1]->name_id != mirror_impl_registry_tests[i]->name_id) {
+            keys[names] = mirror_mph_hash(mirror_impl_registry_tests[i]->name);
+            handles[names++] = i;
+        }
+    }
+    mirror_impl_registry_named = mirror_registry_hash(&mirror_impl_registry_names, keys, handles, names);
+
+    for (i = 0; i < count; ++i) {
+        keys[i] = mirror_impl_registry_tests[i]->key;
+        handles[i] = i;
+    }
+    mirror_impl_registry_keyed = mirror_registry_hash(&mirror_impl_registry_keys, keys, handles, count);
+
+    ghost_free(handles);
+    ghost_free(keys);
+}
+
+/*
+ * Builds the registry from the test tree. This must be called after
+ * mirror_init() and before anything forks.
+ */
+static void mirror_registry_init(void) {
+    mirror_registry_interner_t interner;
+    mirror_all_tests_t* all = mirror_all_tests();
+    ghost_size_t count = mirror_all_tests_count(all);
+    ghost_size_t capacity = 16;
+    ghost_uint32_t* ids; /* of each test's id and description */
+    mirror_registry_slot_t* slot;
+    mirror_test_t* test;
+    ghost_size_t i;
+
+    if (count >= MIRROR_REGISTRY_NONE) {
+        fprintf(stderr, "Too many tests: %" GHOST_PRIuZ ".\n", count);
+        ghost_abort();
+    }
+
+    /* Each test has at most four distinct strings. Keep the table at most
+     * half full. */
+    while (capacity < count * 8)
+        capacity *= 2;
+    interner.slots = ghost_static_cast(mirror_registry_slot_t*,
+            ghost_calloc(capacity, sizeof(mirror_registry_slot_t)));
+    interner.mask = capacity - 1;
+    interner.size = 0;
+    mirror_impl_registry_tests = ghost_static_cast(mirror_test_t**,
+            ghost_calloc(count + 1, sizeof(mirror_test_t*)));
+    ids = ghost_static_cast(ghost_uint32_t*, ghost_calloc(count * 2 + 1, sizeof(ghost_uint32_t)));
+    if (interner.slots == ghost_null || mirror_impl_registry_tests == ghost_null || ids == ghost_null) {
+        fprintf(stderr, "Failed to allocate registry of %" GHOST_PRIuZ " tests.\n", count);
+        ghost_abort();
+    }
+
+    for (i = 0, test = mirror_all_tests_first(all); test != ghost_null;
+            ++i, test = mirror_all_tests_next(all, test))
+    {
+        mirror_impl_registry_tests[i] = test;
+        test->handle = ghost_static_cast(ghost_uint32_t, i);
+        test->key = mirror_registry_key(test);
+        test->name_id = mirror_registry_intern(&interner, test->name);
+        test->file_id = mirror_registry_intern(&interner, test->file);
+        ids[i * 2] = mirror_registry_intern(&interner, test->id);
+        ids[i * 2 + 1] = (test->description == ghost_null) ? MIRROR_REGISTRY_NONE :
+                mirror_registry_intern(&interner, test->description);
+    }
+    mirror_impl_registry_count = ghost_static_cast(ghost_uint32_t, count);
+
+    /* Copy the strings into the table and point the tests at them. */
+    mirror_impl_registry_strings = ghost_static_cast(char*, ghost_calloc(interner.size + 1, 1));
+    if (mirror_impl_registry_strings == ghost_null) {
+        fprintf(stderr, "Failed to allocate string table of %" GHOST_PRIuZ " bytes.\n", interner.size);
+        ghost_abort();
+    }
+    for (i = 0; i <= interner.mask; ++i) {
+        slot = &interner.slots[i];
+        if (slot->string != ghost_null)
+            strcpy(mirror_impl_registry_strings + slot->id, slot->string);
+    }
+    for (i = 0; i < count; ++i) {
+        test = mirror_impl_registry_tests[i];
+        test->name = mirror_impl_registry_strings + test->name_id;
+        test->file = mirror_impl_registry_strings + test->file_id;
+        test->id = mirror_impl_registry_strings + ids[i * 2];
+        if (ids[i * 2 + 1] != MIRROR_REGISTRY_NONE)
+            test->description = mirror_impl_registry_strings + ids[i * 2 + 1];
+        test->name_key.string = test->name;
+    }
+
+    ghost_free(ids);
+    ghost_free(interner.slots);
+
+    mirror_registry_init_hashes();
+}
+
+/*
+ * Frees the registry. The tests' strings are gone after this so nothing may
+ * print them.
+ */
+static void mirror_registry_destroy(void) {
+    mirror_mph_destroy(&mirror_impl_registry_names);
+    mirror_mph_destroy(&mirror_impl_registry_keys);
+    ghost_free(mirror_impl_registry_named);
+    ghost_free(mirror_impl_registry_keyed);
+    ghost_free(mirror_impl_registry_strings);
+    ghost_free(mirror_impl_registry_tests);
+    mirror_impl_registry_named = ghost_null;
+    mirror_impl_registry_keyed = ghost_null;
+    mirror_impl_registry_strings = ghost_null;
+    mirror_impl_registry_tests = ghost_null;
+    mirror_impl_registry_count = 0;
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_REPORT_H
+#define MIRROR_IMPL_INTERNAL_REPORT_H
+
+/*
+ * End-of-run reports of the internal runner.
+ */
+
+#include "mirror/impl/mirror_impl_runner_common.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+/* Sorts slowest first. */
+static int mirror_report_compare_duration(const void* vleft, const void* vright) {
+    const mirror_test_t* left = *ghost_static_cast(mirror_test_t* const*, vleft);
+    const mirror_test_t* right = *ghost_static_cast(mirror_test_t* const*, vright);
+    if (left->duration != right->duration)
+        return (left->duration > right->duration) ? -1 : 1;
+    return 0;
+}
+
+/* Prints nanoseconds as milliseconds. */
+static void mirror_report_ms(ghost_uint64_t nanoseconds) {
+    printf("%5" GHOST_PRIu64 ".%03u ms", nanoseconds / 1000000u,
+            ghost_static_cast(unsigned, nanoseconds / 1000u % 1000u));
+}
+
+/*
+ * Prints the given number of tests that took the longest, with their CPU
+ * time if it was measured.
+ */
+static void mirror_report_slowest(mirror_test_t** tests, ghost_size_t count, ghost_size_t limit) {
+    mirror_test_t** sorted;
+    mirror_test_t* test;
+    ghost_size_t i;
+
+    sorted = ghost_static_cast(mirror_test_t**, ghost_calloc(count + 1, sizeof(mirror_test_t*)));
+    if (sorted == ghost_null)
+        return;
+    memcpy(sorted, tests, count * sizeof(mirror_test_t*));
+    qsort(sorted, count, sizeof(mirror_test_t*), mirror_report_compare_duration);
+
+    if (limit > count)
+        limit = count;
+    printf("Slowest %" GHOST_PRIuZ " tests:\n", limit);
+    for (i = 0; i < limit; ++i) {
+        test = sorted[i];
+        printf("  ");
+        mirror_report_ms(test->duration);
+        if (mirror_impl_time_cpu) {
+            printf("  user ");
+            mirror_report_ms(test->cpu_user);
+            printf("  sys ");
+            mirror_report_ms(test->cpu_system);
+        }
+        printf("  %s (%s:%i)\n", test->name, test->file, test->line);
+    }
+
+    ghost_free(sorted);
+}
+
+/*
+ * Lists the tests that ran and didn't pass in the order they were planned.
+ * Returns how many there were.
+ */
+static ghost_size_t mirror_report_failures(mirror_test_t** tests, ghost_size_t count) {
+    ghost_size_t failed = 0;
+    ghost_size_t i;
+
+    for (i = 0; i < count; ++i) {
+        mirror_test_t* test = tests[i];
+        const char* what;
+        switch (test->status) {
+            case mirror_status_fail: what = "failed"; break;
+            case mirror_status_crash: what = "crashed"; break;
+            case mirror_status_timeout: what = "timed out"; break;
+            default: continue;
+        }
+        if (failed++ == 0)
+            printf("Failed tests:\n");
+        printf("  %s (%s:%i) %s\n", test->name, test->file, test->line, what);
+    }
+
+    return failed;
+}
+
+#endif
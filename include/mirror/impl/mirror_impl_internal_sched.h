@@ -0,0 +1,406 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_SCHED_H
+#define MIRROR_IMPL_INTERNAL_SCHED_H
+
+/*
+ * The internal runner's scheduler.
+ *
+ * Tests that failed last time go first, then new or changed tests, then the
+ * rest (see the history.) Within each group tests are sorted longest-first
+ * by their expected duration. They're dealt out to one deque per worker, each
+ * test going to the deque with the least work so far (the LPT heuristic.) A
+ * worker takes tests from the front of its own deque, so it runs its slowest
+ * tests first. When its deque is empty it steals from the back of whichever
+ * deque has the most work left, taking the shortest tests so the steals even
+ * out the tail of the run.
+ *
+ * A parameterized test is dealt out as several entries so that as many
+ * workers as it has chunks of instances can claim them together. Each entry
+ * counts for the whole test since any one of them may end up running most of
+ * it.
+ *
+ * Only tests that are ready are dealt out. A test that depends on others is
+ * released by the plan once they pass and goes on a queue shared by all
+ * workers, which they check before stealing. A worker that finds nothing to
+ * do while tests are still waiting on dependencies waits for them.
+ *
+ * The thread pool and the process pool both schedule from this. In the
+ * process pool only the parent touches it so the locks are uncontended.
+ */
+
+#include "mirror/impl/mirror_impl_internal_plan.h"
+#include "mirror/impl/mirror_impl_runner_common.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+
+#if MIRROR_THREADS || MIRROR_FORK
+
+typedef struct mirror_deque_t {
+    mirror_test_t** tests; /* this deque's slice of the schedule */
+    ghost_size_t head;     /* the owner takes from here */
+    ghost_size_t tail;     /* thieves take from just before here */
+    ghost_uint64_t load;   /* expected duration of the remaining tests */
+    #if MIRROR_THREADS
+    pthread_mutex_t mutex;
+    #endif
+} mirror_deque_t;
+
+typedef struct mirror_sched_t {
+    mirror_test_t** schedule; /* all tests, grouped by deque */
+    mirror_deque_t* deques;
+    ghost_size_t workers;
+    ghost_uint64_t unknown; /* expected duration of tests with no history */
+
+    /* The rest is only used if tests depend on each other. It's protected
+     * by the mutex. */
+    ghost_bool graph;
+    mirror_test_t** ready; /* tests released by the plan */
+    ghost_size_t ready_head;
+    ghost_size_t ready_tail;
+    ghost_size_t pending;  /* tests waiting on dependencies */
+    ghost_size_t running;  /* tests taken but not done */
+    #if MIRROR_THREADS
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;   /* signalled when tests are released */
+    #endif
+} mirror_sched_t;
+
+typedef struct mirror_sched_entry_t {
+    mirror_test_t* test;
+    ghost_size_t index;   /* registry order, to keep the sort stable */
+    ghost_size_t deque;
+} mirror_sched_entry_t;
+
+static void mirror_deque_lock(mirror_deque_t* deque) {
+    #if MIRROR_THREADS
+    pthread_mutex_lock(&deque->mutex);
+    #else
+    (void)deque;
+    #endif
+}
+
+static void mirror_deque_unlock(mirror_deque_t* deque) {
+    #if MIRROR_THREADS
+    pthread_mutex_unlock(&deque->mutex);
+    #else
+    (void)deque;
+    #endif
+}
+
+static void mirror_sched_lock(mirror_sched_t* sched) {
+    #if MIRROR_THREADS
+    pthread_mutex_lock(&sched->mutex);
+    #else
+    (void)sched;
+    #endif
+}
+
+static void mirror_sched_unlock(mirror_sched_t* sched) {
+    #if MIRROR_THREADS
+    pthread_mutex_unlock(&sched->mutex);
+    #else
+    (void)sched;
+    #endif
+}
+
+static ghost_uint64_t mirror_sched_estimate(const mirror_sched_t* sched, const mirror_test_t* test) {
+    return (test->expected != 0) ? test->expected : sched->unknown;
+}
+
+/* Sorts by history rank, then longest first, then in registry order. */
+static int mirror_sched_compare(const void* vleft, const void* vright) {
+    const mirror_sched_entry_t* left = ghost_static_cast(const mirror_sched_entry_t*, vleft);
+    const mirror_sched_entry_t* right = ghost_static_cast(const mirror_sched_entry_t*, vright);
+    int left_rank = mirror_history_rank(left->test);
+    int right_rank = mirror_history_rank(right->test);
+    if (left_rank != right_rank)
+        return (left_rank < right_rank) ? -1 : 1;
+    if (left->test->expected != right->test->expected)
+        return (left->test->expected > right->test->expected) ? -1 : 1;
+    return (left->index < right->index) ? -1 : (left->index > right->index);
+}
+
+/*
+ * Deals the given tests out to the given number of workers. The tests must
+ * already be planned and have their expected durations (if any) set. Tests
+ * that have already finished (because the plan failed them) are left out.
+ */
+static void mirror_sched_init(mirror_sched_t* sched, mirror_test_t** tests,
+        ghost_size_t count, ghost_size_t workers)
+{
+    mirror_sched_entry_t* entries;
+    ghost_size_t* offsets;
+    ghost_uint64_t known = 0;
+    ghost_uint64_t chunks;
+    ghost_size_t known_count = 0;
+    ghost_size_t total = count;
+    ghost_size_t i, j, k, best, dealt = 0;
+
+    /* Count the extra entries of parameterized tests. */
+    for (i = 0; i < count; ++i) {
+        if (tests[i]->param_size == 0 || tests[i]->status != mirror_status_none ||
+                tests[i]->waiting != 0)
+            continue;
+        chunks = (tests[i]->params.count + MIRROR_PARAMS_CHUNK - 1) / MIRROR_PARAMS_CHUNK;
+        tests[i]->params_entries = (chunks < workers) ? ghost_static_cast(ghost_size_t, chunks) : workers;
+        if (tests[i]->params_entries == 0)
+            tests[i]->params_entries = 1;
+        total += tests[i]->params_entries - 1;
+    }
+
+    sched->workers = workers;
+    sched->graph = ghost_false;
+    sched->ready_head = sched->ready_tail = 0;
+    sched->pending = sched->running = 0;
+    sched->ready = ghost_null;
+    sched->schedule = ghost_static_cast(mirror_test_t**, ghost_calloc(total + 1, sizeof(mirror_test_t*)));
+    sched->deques = ghost_static_cast(mirror_deque_t*, ghost_calloc(workers, sizeof(mirror_deque_t)));
+    entries = ghost_static_cast(mirror_sched_entry_t*, ghost_calloc(total + 1, sizeof(mirror_sched_entry_t)));
+    offsets = ghost_static_cast(ghost_size_t*, ghost_calloc(workers, sizeof(ghost_size_t)));
+    if (sched->schedule == ghost_null || sched->deques == ghost_null ||
+            entries == ghost_null || offsets == ghost_null)
+    {
+        fprintf(stderr, "Failed to allocate schedule of %" GHOST_PRIuZ " tests.\n", count);
+        ghost_abort();
+    }
+
+    /* Tests we've never timed are assumed to be average. */
+    for (i = 0; i < count; ++i) {
+        if (tests[i]->expected != 0) {
+            known += tests[i]->expected;
+            ++known_count;
+        }
+    }
+    sched->unknown = (known_count == 0) ? 1 : known / known_count;
+    if (sched->unknown == 0)
+        sched->unknown = 1;
+
+    for (i = 0; i < count; ++i) {
+        if (tests[i]->status != mirror_status_none)
+            continue;
+        if (tests[i]->waiting != 0) {
+            ++sched->pending;
+            continue;
+        }
+        for (k = (tests[i]->param_size == 0) ? 1 : tests[i]->params_entries; k > 0; --k) {
+            entries[dealt].test = tests[i];
+            entries[dealt].index = i;
+            ++dealt;
+        }
+    }
+    qsort(entries, dealt, sizeof(mirror_sched_entry_t), mirror_sched_compare);
+
+    if (sched->pending != 0) {
+        sched->graph = ghost_true;
+        sched->ready = ghost_static_cast(mirror_test_t**, ghost_calloc(sched->pending, sizeof(mirror_test_t*)));
+        if (sched->ready == ghost_null) {
+            fprintf(stderr, "Failed to allocate schedule of %" GHOST_PRIuZ " tests.\n", count);
+            ghost_abort();
+        }
+    }
+    #if MIRROR_THREADS
+    pthread_mutex_init(&sched->mutex, ghost_null);
+    pthread_cond_init(&sched->cond, ghost_null);
+    #endif
+
+    /* LPT: give each test to the least loaded deque. */
+    for (i = 0; i < dealt; ++i) {
+        best = 0;
+        for (j = 1; j < workers; ++j)
+            if (sched->deques[j].load < sched->deques[best].load)
+                best = j;
+        entries[i].deque = best;
+        sched->deques[best].load += mirror_sched_estimate(sched, entries[i].test);
+        ++sched->deques[best].tail;
+    }
+
+    /* Lay the deques out contiguously, each in longest-first order. */
+    for (i = 0, j = 0; i < workers; ++i) {
+        offsets[i] = j;
+        sched->deques[i].tests = sched->schedule + j;
+        j += sched->deques[i].tail;
+        #if MIRROR_THREADS
+        pthread_mutex_init(&sched->deques[i].mutex, ghost_null);
+        #endif
+    }
+    for (i = 0; i < dealt; ++i)
+        sched->schedule[offsets[entries[i].deque]++] = entries[i].test;
+
+    ghost_free(offsets);
+    ghost_free(entries);
+}
+
+static void mirror_sched_destroy(mirror_sched_t* sched) {
+    #if MIRROR_THREADS
+    ghost_size_t i;
+    for (i = 0; i < sched->workers; ++i)
+        pthread_mutex_destroy(&sched->deques[i].mutex);
+    pthread_mutex_destroy(&sched->mutex);
+    pthread_cond_destroy(&sched->cond);
+    #endif
+    ghost_free(sched->ready);
+    ghost_free(sched->deques);
+    ghost_free(sched->schedule);
+}
+
+/* Steals the shortest test from the deque with the most work left. */
+static mirror_test_t* /*nullable*/ mirror_sched_steal(mirror_sched_t* sched, ghost_size_t worker) {
+    mirror_deque_t* victim;
+    mirror_test_t* test;
+    ghost_uint64_t load;
+    ghost_size_t i, best;
+
+    for (;;) {
+        best = sched->workers;
+        load = 0;
+        for (i = 0; i < sched->workers; ++i) {
+            mirror_deque_t* deque = &sched->deques[i];
+            if (i == worker)
+                continue;
+            mirror_deque_lock(deque);
+            if (deque->head < deque->tail && (best == sched->workers || deque->load > load)) {
+                best = i;
+                load = deque->load;
+            }
+            mirror_deque_unlock(deque);
+        }
+        if (best == sched->workers)
+            return ghost_null;
+
+        /* Someone may have emptied it since we looked. If so, look again. */
+        victim = &sched->deques[best];
+        test = ghost_null;
+        mirror_deque_lock(victim);
+        if (victim->head < victim->tail) {
+            test = victim->tests[--victim->tail];
+            victim->load -= mirror_sched_estimate(sched, test);
+        }
+        mirror_deque_unlock(victim);
+        if (test != ghost_null)
+            return test;
+    }
+}
+
+/* Takes a test released by the plan, if any. */
+static mirror_test_t* /*nullable*/ mirror_sched_take_ready(mirror_sched_t* sched) {
+    mirror_test_t* test = ghost_null;
+    mirror_sched_lock(sched);
+    if (sched->ready_head < sched->ready_tail)
+        test = sched->ready[sched->ready_head++];
+    mirror_sched_unlock(sched);
+    return test;
+}
+
+/*
+ * Returns the next test for the given worker to run, or null if there are
+ * no tests ready anywhere. Tests may still become ready later; see
+ * mirror_sched_wait() and mirror_sched_pending().
+ *
+ * mirror_sched_done() must be called on each test once it has run.
+ */
+static mirror_test_t* /*nullable*/ mirror_sched_take(mirror_sched_t* sched, ghost_size_t worker) {
+    mirror_deque_t* deque = &sched->deques[worker];
+    mirror_test_t* test = ghost_null;
+
+    mirror_deque_lock(deque);
+    if (deque->head < deque->tail) {
+        test = deque->tests[deque->head++];
+        deque->load -= mirror_sched_estimate(sched, test);
+    }
+    mirror_deque_unlock(deque);
+
+    if (test == ghost_null && sched->graph)
+        test = mirror_sched_take_ready(sched);
+    if (test == ghost_null)
+        test = mirror_sched_steal(sched, worker);
+
+    if (test != ghost_null && sched->graph) {
+        mirror_sched_lock(sched);
+        ++sched->running;
+        mirror_sched_unlock(sched);
+    }
+    return test;
+}
+
+/*
+ * Releases or prunes the dependents of a test that has run. A parameterized
+ * test is done when the last of its entries is.
+ */
+static void mirror_sched_done(mirror_sched_t* sched, mirror_test_t* test) {
+    ghost_size_t released, pruned = 0;
+    ghost_bool finished = mirror_params_finish(test);
+    if (!sched->graph)
+        return;
+
+    mirror_sched_lock(sched);
+    --sched->running;
+    if (!finished) {
+        mirror_sched_unlock(sched);
+        return;
+    }
+    released = mirror_plan_done(test, sched->ready + sched->ready_tail, &pruned);
+    sched->ready_tail += released;
+    sched->pending -= released + pruned;
+    #if MIRROR_THREADS
+    pthread_cond_broadcast(&sched->cond);
+    #endif
+    mirror_sched_unlock(sched);
+}
+
+/* Returns true if some tests are still waiting on dependencies. */
+ghost_maybe_unused
+static ghost_bool mirror_sched_pending(mirror_sched_t* sched) {
+    ghost_bool pending;
+    mirror_sched_lock(sched);
+    pending = (sched->pending != 0);
+    mirror_sched_unlock(sched);
+    return pending;
+}
+
+#if MIRROR_THREADS
+/*
+ * Called by a worker thread that found nothing to take. Waits until tests are
+ * released, returning true, or until none can be, returning false.
+ */
+static ghost_bool mirror_sched_wait(mirror_sched_t* sched) {
+    ghost_bool ready;
+    if (!sched->graph)
+        return ghost_false;
+
+    mirror_sched_lock(sched);
+    while (sched->ready_head == sched->ready_tail && sched->pending != 0 && sched->running != 0)
+        pthread_cond_wait(&sched->cond, &sched->mutex);
+    ready = (sched->ready_head < sched->ready_tail);
+    mirror_sched_unlock(sched);
+    return ready;
+}
+#endif
+
+#endif
+
+#endif
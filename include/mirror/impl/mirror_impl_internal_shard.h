@@ -0,0 +1,139 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_SHARD_H
+#define MIRROR_IMPL_INTERNAL_SHARD_H
+
+/*
+ * Sharding of tests across processes or machines.
+ *
+ * Every shard selects its tests from the registry (after filtering)
+ * independently so the same binary run with --shard-index=0 through
+ * --shard-count-1 runs each test exactly once. There are three ways to split:
+ *
+ * - hash: each test goes to the shard given by its key, a hash of its file
+ *   and name (see mirror_registry_key()). A named test stays in the same
+ *   shard as other tests are added or removed. An anonymous test is keyed by
+ *   its id instead, which by default comes from a counter, so it may move
+ *   when a test is added or removed above it in its file. This is the
+ *   default.
+ *
+ * - range: each shard runs a contiguous slice of the registry.
+ *
+ * - duration: each shard runs a contiguous slice of the registry with about
+ *   the same total duration according to the history. All shards must see the
+ *   same history file or they'll disagree on where the slices start.
+ */
+
+#include "mirror/impl/mirror_impl_internal_history.h"
+#include "mirror/impl/mirror_impl_internal_options.h"
+
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+#include <string.h>
+
+/*
+ * Returns the start of the given slice when splitting count tests into the
+ * given number of slices, i.e. count*index/shards.
+ */
+static ghost_size_t mirror_shard_slice(ghost_size_t count, ghost_size_t index, ghost_size_t shards) {
+    /* Split the multiplication so it can't overflow. */
+    return (count / shards) * index + (count % shards) * index / shards;
+}
+
+/*
+ * Narrows the given tests (in registry order) to those of this shard,
+ * keeping their order, and returns how many there are. The history is used
+ * for duration sharding.
+ */
+static ghost_size_t mirror_shard_select(const mirror_options_t* options,
+        const mirror_history_t* history, mirror_test_t** tests, ghost_size_t total)
+{
+    ghost_size_t shards = options->shard_count;
+    ghost_size_t index = options->shard_index;
+    ghost_size_t count = 0;
+    ghost_size_t i;
+    mirror_test_t* test;
+
+    if (shards <= 1)
+        return total;
+
+    if (options->shard_by == mirror_shard_by_hash) {
+        for (i = 0; i < total; ++i)
+            if (tests[i]->key % shards == index)
+                tests[count++] = tests[i];
+
+    } else if (options->shard_by == mirror_shard_by_range) {
+        i = mirror_shard_slice(total, index, shards);
+        count = mirror_shard_slice(total, index + 1, shards) - i;
+        memmove(tests, tests + i, count * sizeof(mirror_test_t*));
+
+    } else {
+        /* Tests with no history count as the average of those with. */
+        ghost_uint64_t known = 0, known_count = 0, unknown, sum, duration, elapsed = 0;
+        mirror_history_entry_t* entry;
+
+        for (i = 0; i < total; ++i) {
+            entry = mirror_history_find(history, tests[i]);
+            if (entry != ghost_null && entry->duration != 0) {
+                known += entry->duration;
+                ++known_count;
+            }
+        }
+        unknown = (known_count == 0) ? 1 : known / known_count;
+        if (unknown == 0)
+            unknown = 1;
+        sum = known + (total - known_count) * unknown;
+
+        /* A test belongs to the shard in which its midpoint falls. Durations
+         * are doubled so the midpoint is exact. */
+        for (i = 0; i < total; ++i) {
+            test = tests[i];
+            entry = mirror_history_find(history, test);
+            duration = (entry != ghost_null && entry->duration != 0) ? entry->duration : unknown;
+            if ((2 * elapsed + duration) * shards / (2 * sum) == index)
+                tests[count++] = test;
+            elapsed += duration;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Tells a GoogleTest-style harness that we understood its sharding variables
+ * by touching the file it named, if any.
+ */
+static void mirror_shard_touch_status_file(void) {
+    const char* path = getenv("GTEST_SHARD_STATUS_FILE");
+    FILE* file;
+    if (path == ghost_null || *path == '\0')
+        return;
+    file = fopen(path, "a");
+    if (file != ghost_null)
+        fclose(file);
+}
+
+#endif
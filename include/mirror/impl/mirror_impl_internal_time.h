@@ -0,0 +1,105 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_TIME_H
+#define MIRROR_IMPL_INTERNAL_TIME_H
+
+/*
+ * Timing of tests.
+ */
+
+#include "mirror/impl/mirror_impl_internal_platform.h"
+
+#include <time.h>
+#if MIRROR_POSIX
+    #include <sys/resource.h>
+#endif
+
+/*
+ * Whether CPU time can be measured per test. getrusage() only gives per-thread
+ * usage where RUSAGE_THREAD exists (Linux with _GNU_SOURCE); elsewhere it's
+ * per-process, which is only meaningful when tests run one at a time in each
+ * process.
+ */
+#ifndef MIRROR_CPU_TIME
+    #define MIRROR_CPU_TIME MIRROR_POSIX
+#endif
+#if MIRROR_CPU_TIME && defined(RUSAGE_THREAD)
+    #define MIRROR_IMPL_RUSAGE_WHO RUSAGE_THREAD
+    #define MIRROR_IMPL_CPU_TIME_PER_THREAD 1
+#else
+    #define MIRROR_IMPL_RUSAGE_WHO RUSAGE_SELF
+    #define MIRROR_IMPL_CPU_TIME_PER_THREAD 0
+#endif
+
+/*
+ * The longest timeout in milliseconds, about 292 years. In nanoseconds it
+ * still fits in 64 bits with room to be added to a timestamp.
+ */
+#define MIRROR_IMPL_TIMEOUT_MAX (~ghost_static_cast(ghost_uint64_t, 0) / 2u / 1000000u)
+
+/*
+ * Whether mirror_run() measures CPU time. It costs a system call or two per
+ * test so it's only turned on when something will report it.
+ */
+static ghost_bool mirror_impl_time_cpu = ghost_false;
+
+/*
+ * Returns a monotonic timestamp in nanoseconds. Only the difference between
+ * two timestamps is meaningful.
+ */
+static ghost_uint64_t mirror_time_now(void) {
+    #if MIRROR_POSIX && defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &now))
+        return ghost_static_cast(ghost_uint64_t, now.tv_sec) * 1000000000u +
+                ghost_static_cast(ghost_uint64_t, now.tv_nsec);
+    #endif
+
+    /* Not wall time but better than nothing. */
+    return ghost_static_cast(ghost_uint64_t, clock()) *
+            (1000000000u / ghost_static_cast(ghost_uint64_t, CLOCKS_PER_SEC));
+}
+
+/*
+ * Gets the user and system CPU time in nanoseconds used so far by the calling
+ * thread (or process; see MIRROR_IMPL_CPU_TIME_PER_THREAD.) Both are zero if
+ * CPU time can't be measured.
+ */
+static void mirror_time_cpu(ghost_uint64_t* user, ghost_uint64_t* system) {
+    #if MIRROR_CPU_TIME
+    struct rusage usage;
+    if (0 == getrusage(MIRROR_IMPL_RUSAGE_WHO, &usage)) {
+        *user = ghost_static_cast(ghost_uint64_t, usage.ru_utime.tv_sec) * 1000000000u +
+                ghost_static_cast(ghost_uint64_t, usage.ru_utime.tv_usec) * 1000u;
+        *system = ghost_static_cast(ghost_uint64_t, usage.ru_stime.tv_sec) * 1000000000u +
+                ghost_static_cast(ghost_uint64_t, usage.ru_stime.tv_usec) * 1000u;
+        return;
+    }
+    #endif
+    *user = 0;
+    *system = 0;
+}
+
+#endif
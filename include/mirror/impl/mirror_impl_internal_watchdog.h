@@ -0,0 +1,150 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_INTERNAL_WATCHDOG_H
+#define MIRROR_IMPL_INTERNAL_WATCHDOG_H
+
+/*
+ * The watchdog thread of the internal runner.
+ *
+ * When tests run in-process (serially or on the thread pool) a hung test
+ * can't be stopped without taking the whole process with it. The watchdog
+ * wakes up periodically and checks each worker's deadline. If a test has
+ * overrun, it reports which one and exits.
+ *
+ * The process pool doesn't use this. The parent enforces timeouts itself by
+ * killing the worker, so the rest of the run carries on.
+ */
+
+#include "mirror/impl/mirror_impl_runner_common.h"
+
+#if MIRROR_THREADS
+
+/* The longest the watchdog sleeps between checks, in nanoseconds */
+#ifndef MIRROR_WATCHDOG_INTERVAL
+    #define MIRROR_WATCHDOG_INTERVAL 50000000u
+#endif
+
+typedef struct mirror_watchdog_t {
+    pthread_t thread;
+    pthread_cond_t cond;
+    mirror_worker_t* /*nullable*/ workers;
+    ghost_bool stop;
+} mirror_watchdog_t;
+
+static mirror_watchdog_t mirror_impl_watchdog;
+
+/* Reports a test that has overrun its deadline and ends the run. */
+static void mirror_watchdog_expire(mirror_worker_t* worker) {
+    mirror_test_t* test = worker->test;
+    mirror_impl_output_lock();
+    printf("Test \"%s\" (%s:%i, id %s) timed out after %lu ms.\n",
+            test->name, test->file, test->line, test->id,
+            ghost_static_cast(unsigned long, mirror_impl_timeout(test) / 1000000u));
+    printf("Stopping the run. Use --fork to continue past timeouts.\n");
+    fflush(stdout);
+    _exit(EXIT_FAILURE);
+}
+
+static void* mirror_watchdog_thread(void* unused) {
+    mirror_watchdog_t* watchdog = &mirror_impl_watchdog;
+    mirror_worker_t* worker;
+    ghost_uint64_t now, wait;
+    struct timespec until;
+    (void)unused;
+
+    pthread_mutex_lock(&mirror_impl_watchdog_mutex);
+    while (!watchdog->stop) {
+        now = mirror_time_now();
+        wait = MIRROR_WATCHDOG_INTERVAL;
+        for (worker = watchdog->workers; worker != ghost_null; worker = worker->watch_next) {
+            if (worker->deadline == 0)
+                continue;
+            if (worker->deadline <= now)
+                mirror_watchdog_expire(worker);
+            if (worker->deadline - now < wait)
+                wait = worker->deadline - now;
+        }
+
+        /* Condition variables wait on the realtime clock. */
+        clock_gettime(CLOCK_REALTIME, &until);
+        wait += ghost_static_cast(ghost_uint64_t, until.tv_nsec);
+        until.tv_sec += ghost_static_cast(time_t, wait / 1000000000u);
+        until.tv_nsec = ghost_static_cast(long, wait % 1000000000u);
+        pthread_cond_timedwait(&watchdog->cond, &mirror_impl_watchdog_mutex, &until);
+    }
+    pthread_mutex_unlock(&mirror_impl_watchdog_mutex);
+    return ghost_null;
+}
+
+/* Adds a worker to be watched. The watchdog must be running. */
+static void mirror_watchdog_watch(mirror_worker_t* worker) {
+    if (!mirror_impl_watchdog_running)
+        return;
+    pthread_mutex_lock(&mirror_impl_watchdog_mutex);
+    worker->deadline = 0;
+    worker->watch_next = mirror_impl_watchdog.workers;
+    mirror_impl_watchdog.workers = worker;
+    pthread_mutex_unlock(&mirror_impl_watchdog_mutex);
+}
+
+/* Stops watching all workers. Call this before freeing them. */
+static void mirror_watchdog_unwatch_all(void) {
+    if (!mirror_impl_watchdog_running)
+        return;
+    pthread_mutex_lock(&mirror_impl_watchdog_mutex);
+    mirror_impl_watchdog.workers = ghost_null;
+    pthread_mutex_unlock(&mirror_impl_watchdog_mutex);
+}
+
+static void mirror_watchdog_start(void) {
+    mirror_watchdog_t* watchdog = &mirror_impl_watchdog;
+    watchdog->workers = ghost_null;
+    watchdog->stop = ghost_false;
+    pthread_cond_init(&watchdog->cond, ghost_null);
+    if (0 != pthread_create(&watchdog->thread, ghost_null, mirror_watchdog_thread, ghost_null)) {
+        fprintf(stderr, "Failed to start watchdog thread. Timeouts will not be enforced.\n");
+        pthread_cond_destroy(&watchdog->cond);
+        return;
+    }
+    mirror_impl_watchdog_running = ghost_true;
+}
+
+static void mirror_watchdog_stop(void) {
+    mirror_watchdog_t* watchdog = &mirror_impl_watchdog;
+    if (!mirror_impl_watchdog_running)
+        return;
+    pthread_mutex_lock(&mirror_impl_watchdog_mutex);
+    watchdog->stop = ghost_true;
+    watchdog->workers = ghost_null;
+    pthread_cond_signal(&watchdog->cond);
+    pthread_mutex_unlock(&mirror_impl_watchdog_mutex);
+    pthread_join(watchdog->thread, ghost_null);
+    pthread_cond_destroy(&watchdog->cond);
+    mirror_impl_watchdog_running = ghost_false;
+}
+
+#endif
+
+#endif
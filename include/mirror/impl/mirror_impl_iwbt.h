@@ -748,6 +748,72 @@ void mirror_iwbt_insert_at(mirror_iwbt_t* mirror_impl_v_tree,
     }
 })
 
+/*
+ * Returns the node at the given index of some sorted sequence.
+ */
+typedef mirror_iwbt_node_t* (*mirror_impl_iwbt_node_at_t)(const void* context, ghost_size_t index);
+
+/*
+ * Links the given range of a sorted sequence into a perfectly balanced subtree
+ * under the given parent, returning its root or null if the range is empty.
+ *
+ * The middle node becomes the root so the left side is never smaller than the
+ * right and their weights differ by at most one. Every subtree is therefore
+ * balanced and no rotations are needed. Recursion depth is logarithmic.
+ */
+ghost_impl_function
+mirror_iwbt_node_t* mirror_impl_iwbt_build(mirror_impl_iwbt_node_at_t node_at, const void* context,
+        ghost_size_t first, ghost_size_t count, mirror_iwbt_node_t* /*nullable*/ parent) GHOST_IMPL_DEF(
+{
+    ghost_size_t left;
+    mirror_iwbt_node_t* node;
+
+    if (count == 0)
+        return ghost_null;
+
+    left = count / 2;
+    node = node_at(context, first + left);
+    node->mirror_impl_v_parent = parent;
+    node->mirror_impl_v_first_child = mirror_impl_iwbt_build(node_at, context, first, left, node);
+    node->mirror_impl_v_last_child = mirror_impl_iwbt_build(node_at, context, first + left + 1, count - left - 1, node);
+    node->mirror_impl_v_weight = count + 1;
+    return node;
+})
+
+/*
+ * Replaces the contents of the tree with a sorted sequence in linear time.
+ */
+ghost_impl_function
+void mirror_impl_iwbt_build_from(mirror_iwbt_t* tree, mirror_impl_iwbt_node_at_t node_at,
+        const void* context, ghost_size_t count) GHOST_IMPL_DEF(
+{
+    ghost_assert(tree != ghost_null, "");
+    tree->mirror_impl_v_root = mirror_impl_iwbt_build(node_at, context, 0, count, ghost_null);
+    mirror_impl_iwbt_sanity_check(tree);
+})
+
+ghost_impl_inline
+mirror_iwbt_node_t* mirror_impl_iwbt_node_array_at(const void* context, ghost_size_t index) {
+    return ghost_static_cast(mirror_iwbt_node_t* const*, context)[index];
+}
+
+/**
+ * Replaces the contents of the tree with the given nodes, in the order given,
+ * in linear time.
+ *
+ * The nodes are linked into a perfectly balanced tree with no rotations, so
+ * this is much faster than inserting them one by one. Any nodes previously in
+ * the tree are discarded without being touched. The array itself is not
+ * retained.
+ */
+ghost_impl_function
+void mirror_iwbt_build_from_sorted(mirror_iwbt_t* tree,
+        mirror_iwbt_node_t* const* nodes, ghost_size_t count) GHOST_IMPL_DEF(
+{
+    ghost_assert(count == 0 || nodes != ghost_null, "");
+    mirror_impl_iwbt_build_from(tree, mirror_impl_iwbt_node_array_at, nodes, count);
+})
+
 /**
  * Returns true if the tree is empty and false otherwise.
  */
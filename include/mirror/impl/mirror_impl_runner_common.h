@@ -30,14 +30,35 @@
  */
 
 #include "mirror/impl/mirror_impl_declare.h"
+#include "mirror/impl/mirror_impl_internal_platform.h"
+#include "mirror/impl/mirror_impl_internal_time.h"
 #include "mirror/impl/mirror_impl_runner_checks.h"
 #include "mirror/impl/mirror_impl_tmmap.h"
 
-/* The largest fixture we'll allocate on the stack */
-#if ghost_has(ghost_alloca)
-    #ifndef MIRROR_FIXTURE_STACK_THRESHOLD
-        #define MIRROR_FIXTURE_STACK_THRESHOLD 64
-    #endif
+/*TODO*/
+#include "ghost/header/c/ghost_stdio_h.h"
+#include "ghost/header/c/ghost_stdlib_h.h"
+
+/* The initial size of each worker's fixture arena. It grows to fit the
+ * largest test. */
+#ifndef MIRROR_FIXTURE_ARENA_SIZE
+    #define MIRROR_FIXTURE_ARENA_SIZE 4096
+#endif
+
+/* The alignment of fixtures. Define this to 64 for example to give each
+ * fixture its own cache line. */
+#ifndef MIRROR_FIXTURE_ALIGN
+    #define MIRROR_FIXTURE_ALIGN sizeof(mirror_impl_max_align_t)
+#endif
+
+/* The number of cases of a property test that doesn't give a count */
+#ifndef MIRROR_PROPERTY_CASES
+    #define MIRROR_PROPERTY_CASES 100
+#endif
+
+/* The most candidates tried while shrinking a failing case of a property */
+#ifndef MIRROR_PROPERTY_SHRINKS
+    #define MIRROR_PROPERTY_SHRINKS 10000
 #endif
 
 #ifdef __cplusplus
@@ -51,9 +72,9 @@ MIRROR_TMMAP_TYPE(mirror_suite_suites)
 
 typedef int ghost_impl_chibicc_unused4; /* chibicc workaround: https://github.com/rui314/chibicc/issues/99 */
 
-#define mirror_tests_key(test) test->name
-MIRROR_TMMAP_STATIC(mirror_all_tests, const char*, mirror_test_t, all_tests, mirror_tests_key, ghost_strcmp)
-MIRROR_TMMAP_STATIC(mirror_suite_tests, const char*, mirror_test_t, suite_tests, mirror_tests_key, ghost_strcmp)
+#define mirror_tests_key(test) (&test->name_key)
+MIRROR_TMMAP_STATIC(mirror_all_tests, const mirror_strkey_t*, mirror_test_t, all_tests, mirror_tests_key, mirror_strkey_compare)
+MIRROR_TMMAP_STATIC(mirror_suite_tests, const mirror_strkey_t*, mirror_test_t, suite_tests, mirror_tests_key, mirror_strkey_compare)
 
 typedef int ghost_impl_chibicc_unused3; /* chibicc workaround: https://github.com/rui314/chibicc/issues/99 */
 
@@ -66,70 +87,676 @@ static mirror_all_tests_t* mirror_all_tests(void) {
     static mirror_all_tests_t tests;
     return &tests;
 }
+static mirror_all_suites_t* mirror_all_suites(void) {
+    static mirror_all_suites_t suites;
+    return &suites;
+}
 #if 0
 static mirror_suite_tests_t* mirror_suite_tests(void) {
     static mirror_suite_tests_t tests;
     return &tests;
 }
-static mirror_all_suites_t* mirror_all_suites(void) {
-    static mirror_all_suites_t suites;
-    return &suites;
-}
 static mirror_suite_suites_t* mirror_suite_suites(void) {
     static mirror_suite_suites_t suites;
     return &suites;
 }
 #endif
 
+/* A type at least as strictly aligned as any fundamental type */
+typedef union mirror_impl_max_align_t {
+    long double ld;
+    double d;
+    long l;
+    ghost_uint64_t u;
+    void* p;
+    void (*fn)(void);
+} mirror_impl_max_align_t;
+
+/*
+ * A bump allocator for the fixtures of the tests that run on a worker. It's
+ * reset before each test so tests that fit in it allocate nothing.
+ *
+ * Allocations that don't fit get their own blocks, chained on overflow, since
+ * anything already allocated can't move. At the next reset these are freed
+ * and the arena grows to hold them all.
+ */
+typedef struct mirror_impl_arena_t {
+    void* /*nullable*/ block; /* as allocated */
+    char* start; /* in block, aligned */
+    ghost_size_t size;
+    ghost_size_t used;
+    ghost_size_t wanted; /* since the reset, including overflow */
+    void* /*nullable*/ overflow; /* each starts with a pointer to the next */
+} mirror_impl_arena_t;
+
+/* The number of suites, numbered by mirror_init(). */
+static ghost_size_t mirror_impl_suite_count;
+
+/* A worker's copy of the shared fixture of a suite. */
+typedef struct mirror_impl_shared_t {
+    void* /*nullable*/ fixture; /* null until a test of the suite needs it */
+    ghost_bool failed; /* its setup failed so its tests can't run */
+} mirror_impl_shared_t;
+
+/*
+ * A worker runs tests one at a time. Each thread of the runner has its own
+ * worker; a serial run has just one.
+ *
+ * A failing check finds the test it belongs to through the current thread's
+ * worker.
+ */
+typedef struct mirror_worker_t mirror_worker_t;
+
+struct mirror_worker_t {
+    ghost_size_t index;
+    mirror_test_t* /*nullable*/ test; /* the test currently running */
+    mirror_status_t status; /* of the current (or last) run */
+    ghost_uint64_t cpu_user; /* CPU time of the last run, if measured */
+    ghost_uint64_t cpu_system;
+
+    /* The instance of a parameterized test that's running and its param */
+    ghost_uint64_t instance;
+    void* /*nullable*/ param;
+
+    /* While shrinking a property, the candidate param to run instead of
+     * making one, and whether failures go unreported */
+    const void* /*nullable*/ candidate;
+    ghost_bool quiet;
+
+    /* The instances a worker process was sent. If empty the worker claims
+     * instances itself. */
+    ghost_uint64_t params_first;
+    ghost_uint64_t params_end;
+
+    /* Called when a check fails just before the process is brought down
+     * (with --fail-fast.) */
+    void (*/*nullable*/ failure_hook)(mirror_worker_t* worker);
+
+    /* The shared fixtures of suites, indexed by suite, or null until a test
+     * in a suite runs here. They're torn down by mirror_worker_finish(). */
+    mirror_impl_shared_t* /*nullable*/ shared;
+
+    /* Where the fixture of the current test is allocated */
+    mirror_impl_arena_t arena;
+
+    #if !MIRROR_EXCEPTIONS
+    jmp_buf unwind; /* where a failed check returns to in mirror_run() */
+    #endif
+
+    /* When the current test times out, or 0 if it can't. This is protected
+     * by the watchdog mutex. */
+    ghost_uint64_t deadline;
+    mirror_worker_t* /*nullable*/ watch_next; /* list of workers being watched */
+
+    #if MIRROR_THREADS
+    pthread_t thread;
+    #endif
+};
+
+static MIRROR_IMPL_THREAD_LOCAL mirror_worker_t* mirror_impl_worker;
+
+/* Whether the first failed check ends the run rather than just its test. */
+static ghost_bool mirror_impl_fail_fast;
+
+#if MIRROR_EXCEPTIONS
+/* Thrown by a failed check to unwind its test. */
+struct mirror_impl_failure_t {
+    int unused;
+};
+#endif
+
+/* Serializes output from workers so that reports don't interleave. */
+#if MIRROR_THREADS
+static pthread_mutex_t mirror_impl_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void mirror_impl_output_lock(void) {
+    #if MIRROR_THREADS
+    pthread_mutex_lock(&mirror_impl_output_mutex);
+    #endif
+}
+
+ghost_maybe_unused
+static void mirror_impl_output_unlock(void) {
+    #if MIRROR_THREADS
+    pthread_mutex_unlock(&mirror_impl_output_mutex);
+    #endif
+}
+
+/*
+ * Protects the results and unclaimed instances of parameterized tests, which
+ * several workers may be running at once.
+ */
+#if MIRROR_THREADS
+static pthread_mutex_t mirror_impl_params_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void mirror_impl_params_lock(void) {
+    #if MIRROR_THREADS
+    pthread_mutex_lock(&mirror_impl_params_mutex);
+    #endif
+}
+
+static void mirror_impl_params_unlock(void) {
+    #if MIRROR_THREADS
+    pthread_mutex_unlock(&mirror_impl_params_mutex);
+    #endif
+}
+
+/* The timeout for tests that don't specify one, in milliseconds, or 0. */
+static unsigned long mirror_impl_default_timeout;
+
+/* The seed of the random inputs of property tests */
+static ghost_uint64_t mirror_impl_seed;
+
+/*
+ * Returns the timeout of the given test in nanoseconds, or 0 for none. A
+ * timeout() beyond MIRROR_IMPL_TIMEOUT_MAX is clamped to it.
+ */
+static ghost_uint64_t mirror_impl_timeout(const mirror_test_t* test) {
+    unsigned long ms = (test->timeout != 0) ? test->timeout : mirror_impl_default_timeout;
+    if (ghost_static_cast(ghost_uint64_t, ms) > MIRROR_IMPL_TIMEOUT_MAX)
+        return MIRROR_IMPL_TIMEOUT_MAX * 1000000u;
+    return ghost_static_cast(ghost_uint64_t, ms) * 1000000u;
+}
+
+/*
+ * The watchdog thread (if running) checks the deadlines of workers. It's
+ * started before any workers so the flag itself needs no lock.
+ */
+#if MIRROR_THREADS
+static ghost_bool mirror_impl_watchdog_running;
+static pthread_mutex_t mirror_impl_watchdog_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void mirror_impl_watchdog_arm(mirror_worker_t* worker, ghost_uint64_t deadline) {
+    #if MIRROR_THREADS
+    if (mirror_impl_watchdog_running) {
+        pthread_mutex_lock(&mirror_impl_watchdog_mutex);
+        worker->deadline = deadline;
+        pthread_mutex_unlock(&mirror_impl_watchdog_mutex);
+    }
+    #else
+    (void)worker;
+    (void)deadline;
+    #endif
+}
+
+void mirror_handle_failure(const char* file, int line, const char* message) {
+    mirror_worker_t* worker = mirror_impl_worker;
+    char report[1536];
+    int length = 0;
+
+    /* A property being shrunk is expected to fail. Only its smallest
+     * failing case is reported. */
+    if (worker != ghost_null && worker->test != ghost_null && worker->quiet) {
+        worker->status = mirror_status_fail;
+        #if MIRROR_EXCEPTIONS
+        throw mirror_impl_failure_t();
+        #else
+        longjmp(worker->unwind, 1);
+        #endif
+    }
+
+    /* The report is written all at once so that it doesn't interleave with
+     * output from other worker processes. */
+    if (worker != ghost_null && worker->test != ghost_null && worker->candidate != ghost_null)
+        length = ghost_snprintf(report, sizeof(report), "Test \"%s\" (%s:%i) failed with its shrunk param.\n",
+                worker->test->name, worker->test->file, worker->test->line);
+    else if (worker != ghost_null && worker->test != ghost_null && worker->test->param_size != 0)
+        length = ghost_snprintf(report, sizeof(report), "Test \"%s\" (%s:%i) failed with param %lu.\n",
+                worker->test->name, worker->test->file, worker->test->line,
+                ghost_static_cast(unsigned long, worker->instance));
+    else if (worker != ghost_null && worker->test != ghost_null)
+        length = ghost_snprintf(report, sizeof(report), "Test \"%s\" (%s:%i) failed.\n",
+                worker->test->name, worker->test->file, worker->test->line);
+    if (length < 0 || ghost_static_cast(ghost_size_t, length) >= sizeof(report))
+        length = 0;
+    ghost_snprintf(report + length, sizeof(report) - ghost_static_cast(ghost_size_t, length),
+            "%s:%i %s", file, line, message);
+
+    mirror_impl_output_lock();
+    fputs(report, stdout);
+    fflush(stdout);
+
+    /* Unwind just this test. A check that fails outside of any test has
+     * nowhere to go. */
+    if (!mirror_impl_fail_fast && worker != ghost_null && worker->test != ghost_null) {
+        worker->status = mirror_status_fail;
+        mirror_impl_output_unlock();
+        #if MIRROR_EXCEPTIONS
+        throw mirror_impl_failure_t();
+        #else
+        longjmp(worker->unwind, 1);
+        #endif
+    }
+
+    /* We never unlock. Other workers block on their next report while we
+     * bring the process down. */
+    if (worker != ghost_null && worker->failure_hook != ghost_null)
+        worker->failure_hook(worker);
+    ghost_fatal("");
+}
+
+#if MIRROR_SECTION_REGISTRY && !MIRROR_GENERATED_REGISTRY
+/*
+ * The registration blocks of all tests, gathered by the linker. These are
+ * weak so that a program without tests still links.
+ */
+extern const mirror_registration_t __start_mirror_tests[]
+        __attribute__((__weak__, __visibility__("hidden")));
+extern const mirror_registration_t __stop_mirror_tests[]
+        __attribute__((__weak__, __visibility__("hidden")));
+#endif
+
+#if MIRROR_SECTION_REGISTRY || MIRROR_GENERATED_REGISTRY
+typedef struct mirror_impl_registered_t {
+    mirror_test_t* test;
+    ghost_size_t index; /* registration order, to keep the sort stable */
+} mirror_impl_registered_t;
+
+static mirror_impl_registered_t* mirror_impl_registered;
+static ghost_size_t mirror_impl_registered_count;
+
+static int mirror_impl_registered_compare(const void* vleft, const void* vright) {
+    const mirror_impl_registered_t* left = ghost_static_cast(const mirror_impl_registered_t*, vleft);
+    const mirror_impl_registered_t* right = ghost_static_cast(const mirror_impl_registered_t*, vright);
+    int cmp = mirror_strkey_compare(&left->test->name_key, &right->test->name_key);
+    if (cmp != 0)
+        return cmp;
+    return (left->index < right->index) ? -1 : (left->index > right->index);
+}
+
+void mirror_register_test(mirror_test_t* test) {
+    mirror_strkey_init(&test->name_key, test->name);
+    mirror_impl_registered[mirror_impl_registered_count].test = test;
+    mirror_impl_registered[mirror_impl_registered_count].index = mirror_impl_registered_count;
+    ++mirror_impl_registered_count;
+}
+
+/*
+ * Runs all registration blocks in the given table (the section or the
+ * generated registry), sorts the tests by name and builds the test tree from
+ * them in one pass.
+ */
+static void mirror_impl_register_table(const mirror_registration_t* table, ghost_size_t count) {
+    mirror_test_t** tests;
+    ghost_size_t i;
+
+    if (count == 0)
+        return;
+
+    mirror_impl_registered = ghost_static_cast(mirror_impl_registered_t*,
+            ghost_calloc(count, sizeof(mirror_impl_registered_t)));
+    tests = ghost_static_cast(mirror_test_t**, ghost_calloc(count, sizeof(mirror_test_t*)));
+    if (mirror_impl_registered == ghost_null || tests == ghost_null) {
+        fprintf(stderr, "Failed to allocate registry of %" GHOST_PRIuZ " tests.\n", count);
+        ghost_abort();
+    }
+    for (i = 0; i < count; ++i)
+        table[i]();
+
+    qsort(mirror_impl_registered, mirror_impl_registered_count,
+            sizeof(mirror_impl_registered_t), mirror_impl_registered_compare);
+    for (i = 0; i < mirror_impl_registered_count; ++i)
+        tests[i] = mirror_impl_registered[i].test;
+    mirror_all_tests_build_sorted(mirror_all_tests(), tests, mirror_impl_registered_count);
+
+    ghost_free(tests);
+    ghost_free(mirror_impl_registered);
+    mirror_impl_registered = ghost_null;
+}
+#else
 void mirror_register_test(mirror_test_t* test) {
+    mirror_strkey_init(&test->name_key, test->name);
     mirror_all_tests_insert_last(mirror_all_tests(), test);
 }
+#endif
 
-static void mirror_init(void) {
+void mirror_register_suite(mirror_suite_t* suite) {
+    mirror_all_suites_insert_last(mirror_all_suites(), suite);
+}
 
-    #if !ghost_has(ghost_static_init)
-    mirror_register_all();
-    #endif
+/*
+ * Numbers the suites and links the tests with them. Tests in suites that
+ * aren't declared are an error, as are tests that take a fixture that
+ * doesn't fit their suite's.
+ */
+static void mirror_impl_link_suites(void) {
+    mirror_all_suites_t* suites = mirror_all_suites();
+    mirror_all_tests_t* tests = mirror_all_tests();
+    mirror_suite_t* previous = ghost_null;
+    mirror_suite_t* suite;
+    mirror_test_t* test;
+    ghost_bool error = ghost_false;
 
-    #if 0
-    /* Link all test cases with their suites. */
-    for (mirror_test_t* test = mirror_test_first;
-            test != ghost_null; test = test->next_globally) {
-
-        /* Find the test suite for this test case */
-        mirror_suite_t* suite;
-        for (suite = mirror_suite_first;; suite = suite->next_globally) {
-            if (suite == ghost_null) {
-
-                /* No suite was found with a matching name. Create one. */
-                #if ghost_has(ghost_alloc_zero)
-                    printf("Allocated test suite for %s\n", test->name);
-                    suite = ghost_alloc_zero(mirror_suite_t);
-                    suite->name = test->suite_name;
-                    suite->allocated = ghost_true;
-                    suite->next_globally = mirror_suite_first;
-                    mirror_suite_first = suite;
-                    suite->first_test = test;
-                    test->suite = suite;
-                    break;
-                #else
-                    fprintf(stderr, "ERROR: No ghost test suite found for %s/%s "
-                            "(and no malloc() available to create it.)\n",
-                            test->suite_name, test->name);
-                    ghost_abort();
-                #endif
-            }
-
-            if (0 == ghost_strcmp(test->suite_name, suite->name)) {
-                test->suite = suite;
-                test->next_in_suite = suite->first_test;
-                suite->first_test = test;
-                break;
-            }
+    for (suite = mirror_all_suites_first(suites); suite != ghost_null;
+            suite = mirror_all_suites_next(suites, suite))
+    {
+        if (previous != ghost_null && 0 == ghost_strcmp(previous->name, suite->name)) {
+            fprintf(stderr, "ERROR: Suite \"%s\" is declared twice (%s:%i and %s:%i).\n",
+                    suite->name, previous->file, previous->line, suite->file, suite->line);
+            error = ghost_true;
+        }
+        suite->index = mirror_impl_suite_count++;
+        previous = suite;
+    }
+
+    for (test = mirror_all_tests_first(tests); test != ghost_null;
+            test = mirror_all_tests_next(tests, test))
+    {
+        if (test->suite_name == ghost_null)
+            continue;
+        suite = mirror_all_suites_find_first(suites, test->suite_name);
+        if (suite == ghost_null) {
+            fprintf(stderr, "ERROR: Test \"%s\" (%s:%i) is in suite \"%s\" which isn't declared.\n",
+                    test->name, test->file, test->line, test->suite_name);
+            error = ghost_true;
+            continue;
+        }
+        test->suite = suite;
+
+        /* The fixture types can't be compared so we compare their sizes. */
+        if (test->fixture_size == 0)
+            continue;
+        if (test->fixture_size != suite->fixture_size) {
+            fprintf(stderr, "ERROR: The fixture of test \"%s\" (%s:%i) doesn't match "
+                    "that of its suite \"%s\" (%s:%i).\n",
+                    test->name, test->file, test->line, suite->name, suite->file, suite->line);
+            error = ghost_true;
+        } else if (test->fixture_setup != ghost_null || test->fixture_teardown != ghost_null) {
+            fprintf(stderr, "ERROR: Test \"%s\" (%s:%i) shares the fixture of suite \"%s\" "
+                    "so it can't have its own setup or teardown.\n",
+                    test->name, test->file, test->line, suite->name);
+            error = ghost_true;
         }
     }
+
+    if (error)
+        exit(EXIT_FAILURE);
+}
+
+static void mirror_impl_params_make_array(const mirror_params_t* params, void* param,
+        ghost_size_t param_size, ghost_uint64_t index)
+{
+    const char* array = ghost_static_cast(const char*, params->array);
+    memcpy(param, array + ghost_static_cast(ghost_size_t, index) * param_size, param_size);
+}
+
+/* Stores an integer param of the given size. */
+static void mirror_impl_store_integer(void* param, ghost_size_t param_size, ghost_int64_t value) {
+    switch (param_size) {
+        case 1: *ghost_static_cast(ghost_int8_t*, param) = ghost_static_cast(ghost_int8_t, value); break;
+        case 2: *ghost_static_cast(ghost_int16_t*, param) = ghost_static_cast(ghost_int16_t, value); break;
+        case 4: *ghost_static_cast(ghost_int32_t*, param) = ghost_static_cast(ghost_int32_t, value); break;
+        default: *ghost_static_cast(ghost_int64_t*, param) = value; break;
+    }
+}
+
+static ghost_int64_t mirror_impl_load_integer(const void* param, ghost_size_t param_size) {
+    switch (param_size) {
+        case 1: return *ghost_static_cast(const ghost_int8_t*, param);
+        case 2: return *ghost_static_cast(const ghost_int16_t*, param);
+        case 4: return *ghost_static_cast(const ghost_int32_t*, param);
+        default: return *ghost_static_cast(const ghost_int64_t*, param);
+    }
+}
+
+static ghost_bool mirror_impl_integer_size(ghost_size_t param_size) {
+    return param_size == 1 || param_size == 2 || param_size == 4 || param_size == 8;
+}
+
+static void mirror_impl_params_make_range(const mirror_params_t* params, void* param,
+        ghost_size_t param_size, ghost_uint64_t index)
+{
+    mirror_impl_store_integer(param, param_size, params->first + ghost_static_cast(ghost_int64_t, index));
+}
+
+static void mirror_impl_params_make_generated(const mirror_params_t* params, void* param,
+        ghost_size_t param_size, ghost_uint64_t index)
+{
+    (void)param_size;
+    params->generate(param, index, params->context);
+}
+
+mirror_params_t mirror_params_of(const void* array, ghost_size_t element_size, ghost_uint64_t count) {
+    mirror_params_t params = GHOST_ZERO_INIT;
+    params.count = count;
+    params.make = mirror_impl_params_make_array;
+    params.array = array;
+    params.element_size = element_size;
+    return params;
+}
+
+mirror_params_t mirror_params_range(ghost_int64_t first, ghost_int64_t end) {
+    mirror_params_t params = GHOST_ZERO_INIT;
+    params.count = (end > first) ? ghost_static_cast(ghost_uint64_t, end - first) : 0;
+    params.make = mirror_impl_params_make_range;
+    params.first = first;
+    return params;
+}
+
+mirror_params_t mirror_params_generate(ghost_uint64_t count,
+        void (*generate)(void* param, ghost_uint64_t index, void* context), void* context)
+{
+    mirror_params_t params = GHOST_ZERO_INIT;
+    params.count = count;
+    params.make = mirror_impl_params_make_generated;
+    params.generate = generate;
+    params.context = context;
+    return params;
+}
+
+/* The splitmix64 generator. Its output is a good hash of its state. */
+static ghost_uint64_t mirror_impl_random_mix(ghost_uint64_t z) {
+    z ^= z >> 30;
+    z *= 0xbf58476d1ce4e5b9u;
+    z ^= z >> 27;
+    z *= 0x94d049bb133111ebu;
+    return z ^ (z >> 31);
+}
+
+ghost_uint64_t mirror_random_next(mirror_random_t* random) {
+    random->state += 0x9e3779b97f4a7c15u;
+    return mirror_impl_random_mix(random->state);
+}
+
+ghost_uint64_t mirror_random_below(mirror_random_t* random, ghost_uint64_t bound) {
+    /* Values below the threshold would make the low results more likely. */
+    ghost_uint64_t threshold = (0 - bound) % bound;
+    ghost_uint64_t value;
+    do {
+        value = mirror_random_next(random);
+    } while (value < threshold);
+    return value % bound;
+}
+
+/* Makes the param of a case of a property. */
+static void mirror_impl_params_make_property(const mirror_params_t* params, void* param,
+        ghost_size_t param_size, ghost_uint64_t index)
+{
+    const mirror_property_t* property = ghost_static_cast(const mirror_property_t*, params->context);
+    mirror_random_t random;
+    random.state = mirror_impl_random_mix(mirror_impl_seed ^ mirror_impl_random_mix(index + 1));
+    property->generate(property, param, param_size, &random);
+}
+
+static ghost_int64_t mirror_impl_property_clamp(const mirror_property_t* property, ghost_int64_t value) {
+    return (value < property->min) ? property->min : (value > property->max) ? property->max : value;
+}
+
+static void mirror_impl_property_generate_integers(const mirror_property_t* property, void* param,
+        ghost_size_t param_size, mirror_random_t* random)
+{
+    ghost_uint64_t span = ghost_static_cast(ghost_uint64_t, property->max) -
+            ghost_static_cast(ghost_uint64_t, property->min);
+    ghost_int64_t value;
+
+    /* Bugs live at the edges so one case in eight takes an edge. */
+    switch (mirror_random_below(random, 24)) {
+        case 0: value = property->min; break;
+        case 1: value = property->max; break;
+        case 2: value = mirror_impl_property_clamp(property, 0); break;
+        default:
+            value = ghost_static_cast(ghost_int64_t, ghost_static_cast(ghost_uint64_t, property->min) +
+                    ((span + 1 == 0) ? mirror_random_next(random) : mirror_random_below(random, span + 1)));
+            break;
+    }
+    mirror_impl_store_integer(param, param_size, value);
+}
+
+/* Tries zero (or the nearest bound), then halfway there, then a quarter of
+ * the way and so on down to one step closer. */
+static ghost_bool mirror_impl_property_shrink_integers(const mirror_property_t* property, void* candidate,
+        const void* param, ghost_size_t param_size, ghost_uint64_t attempt)
+{
+    ghost_int64_t value = mirror_impl_load_integer(param, param_size);
+    ghost_int64_t target = mirror_impl_property_clamp(property, 0);
+    ghost_uint64_t distance, step;
+
+    distance = (value > target) ?
+            ghost_static_cast(ghost_uint64_t, value) - ghost_static_cast(ghost_uint64_t, target) :
+            ghost_static_cast(ghost_uint64_t, target) - ghost_static_cast(ghost_uint64_t, value);
+    if (attempt >= 64)
+        return ghost_false;
+    step = distance >> attempt;
+    if (step == 0)
+        return ghost_false;
+
+    mirror_impl_store_integer(candidate, param_size, ghost_static_cast(ghost_int64_t, (value > target) ?
+            ghost_static_cast(ghost_uint64_t, value) - step :
+            ghost_static_cast(ghost_uint64_t, value) + step));
+    return ghost_true;
+}
+
+static void mirror_impl_property_print_integers(const mirror_property_t* property,
+        const void* param, ghost_size_t param_size)
+{
+    (void)property;
+    printf("%ld", ghost_static_cast(long, mirror_impl_load_integer(param, param_size)));
+}
+
+mirror_property_t mirror_property_integers(ghost_uint64_t count, ghost_int64_t min, ghost_int64_t max) {
+    mirror_property_t property = GHOST_ZERO_INIT;
+    property.count = count;
+    property.generate = mirror_impl_property_generate_integers;
+    property.shrink = mirror_impl_property_shrink_integers;
+    property.print = mirror_impl_property_print_integers;
+    property.min = min;
+    property.max = (max < min) ? min : max;
+    return property;
+}
+
+mirror_property_t mirror_property_generate(ghost_uint64_t count,
+        void (*generate)(const mirror_property_t* property, void* param,
+            ghost_size_t param_size, mirror_random_t* random),
+        ghost_bool (*shrink)(const mirror_property_t* property, void* candidate,
+            const void* param, ghost_size_t param_size, ghost_uint64_t attempt),
+        void (*print)(const mirror_property_t* property, const void* param, ghost_size_t param_size),
+        void* context)
+{
+    mirror_property_t property = GHOST_ZERO_INIT;
+    property.count = count;
+    property.generate = generate;
+    property.shrink = shrink;
+    property.print = print;
+    property.context = context;
+    return property;
+}
+
+/*
+ * Checks that each parameterized test has parameters that fit its param()
+ * and nothing it can't be combined with. A property becomes the params() of
+ * its test.
+ */
+static void mirror_impl_check_params(void) {
+    mirror_all_tests_t* tests = mirror_all_tests();
+    mirror_test_t* test;
+    ghost_bool error = ghost_false;
+
+    for (test = mirror_all_tests_first(tests); test != ghost_null;
+            test = mirror_all_tests_next(tests, test))
+    {
+        if (test->param_size == 0 && test->params.make == ghost_null &&
+                test->property.generate == ghost_null && test->corpus == ghost_null)
+            continue;
+        test->params_next = 0;
+        test->params_entries = 1;
+
+        if ((test->params.make != ghost_null) + (test->property.generate != ghost_null) +
+                (test->corpus != ghost_null) > 1)
+        {
+            fprintf(stderr, "ERROR: Test \"%s\" (%s:%i) can only have one of params(), "
+                    "property() and corpus().\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+            continue;
+        }
+
+        /* The records are filled in when the corpus is loaded. */
+        if (test->corpus != ghost_null)
+            test->params = mirror_params_of(ghost_null, sizeof(mirror_record_t), 0);
+
+        if (test->property.generate != ghost_null) {
+            test->params.count = (test->property.count != 0) ? test->property.count : MIRROR_PROPERTY_CASES;
+            test->params.make = mirror_impl_params_make_property;
+            test->params.context = &test->property;
+        }
+
+        if (test->params.make == ghost_null) {
+            fprintf(stderr, "ERROR: Test \"%s\" (%s:%i) has a param() but no params().\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+        } else if (test->param_size == 0) {
+            fprintf(stderr, "ERROR: Test \"%s\" (%s:%i) takes parameters but has no param().\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+        } else if (test->corpus != ghost_null && test->param_size != sizeof(mirror_record_t)) {
+            fprintf(stderr, "ERROR: The param() of test \"%s\" (%s:%i) "
+                    "must be a mirror_record_t to take a corpus.\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+        } else if (test->params.make == mirror_impl_params_make_array &&
+                test->params.element_size != test->param_size)
+        {
+            fprintf(stderr, "ERROR: The params() array of test \"%s\" (%s:%i) "
+                    "doesn't match the type of its param().\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+        } else if ((test->params.make == mirror_impl_params_make_range ||
+                    test->property.generate == mirror_impl_property_generate_integers) &&
+                !mirror_impl_integer_size(test->param_size))
+        {
+            fprintf(stderr, "ERROR: The param() of test \"%s\" (%s:%i) "
+                    "must be an integer to take a range of integers.\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+        } else if (test->death) {
+            fprintf(stderr, "ERROR: Test \"%s\" (%s:%i) can't be both a death test "
+                    "and parameterized.\n",
+                    test->name, test->file, test->line);
+            error = ghost_true;
+        }
+    }
+
+    if (error)
+        exit(EXIT_FAILURE);
+}
+
+static void mirror_init(void) {
+
+    #if MIRROR_GENERATED_REGISTRY
+    mirror_impl_register_table(mirror_registry, mirror_registry_count);
+    #elif MIRROR_SECTION_REGISTRY
+    if (__start_mirror_tests != ghost_null)
+        mirror_impl_register_table(__start_mirror_tests,
+                ghost_static_cast(ghost_size_t, __stop_mirror_tests - __start_mirror_tests));
     #endif
 
+    /* Link all test cases with their suites. */
+    mirror_impl_link_suites();
+    mirror_impl_check_params();
+
     /* Link all test suites with their parents.
      * TODO */
 
@@ -149,9 +776,201 @@ static void mirror_teardown(void) {
 
 }
 
-/* We noinline this explicitly because we use alloca() for the fixture. */
-ghost_noinline
-static void mirror_run(mirror_test_t* test) {
+typedef enum mirror_impl_phase_t {
+    mirror_impl_phase_setup,
+    mirror_impl_phase_test,
+    mirror_impl_phase_teardown,
+    mirror_impl_phase_shared_setup /* of the test's suite */
+} mirror_impl_phase_t;
+
+static void mirror_impl_call_phase(mirror_worker_t* worker, mirror_test_t* test,
+        mirror_impl_phase_t phase, void* fixture)
+{
+    switch (phase) {
+        case mirror_impl_phase_setup: test->fixture_setup(fixture); break;
+        case mirror_impl_phase_test: test->fn(fixture, worker->param); break;
+        case mirror_impl_phase_teardown: test->fixture_teardown(fixture); break;
+        case mirror_impl_phase_shared_setup: test->suite->fixture_setup(fixture); break;
+    }
+}
+
+/*
+ * Calls the given phase of a test. Returns false if a check failed in it, in
+ * which case the rest of the phase was skipped.
+ */
+static ghost_bool mirror_impl_call(mirror_worker_t* worker, mirror_test_t* test,
+        mirror_impl_phase_t phase, void* fixture)
+{
+    #if MIRROR_EXCEPTIONS
+    try {
+        mirror_impl_call_phase(worker, test, phase, fixture);
+    } catch (const mirror_impl_failure_t&) {
+        return ghost_false;
+    }
+    #else
+    if (0 != setjmp(worker->unwind))
+        return ghost_false;
+    mirror_impl_call_phase(worker, test, phase, fixture);
+    #endif
+    return ghost_true;
+}
+
+static ghost_size_t mirror_impl_arena_round(ghost_size_t size) {
+    return (size + MIRROR_FIXTURE_ALIGN - 1) / MIRROR_FIXTURE_ALIGN * MIRROR_FIXTURE_ALIGN;
+}
+
+/* Allocates a block and returns its first aligned byte. */
+static char* mirror_impl_arena_block(void** block, ghost_size_t size) {
+    ghost_size_t misalign;
+    *block = ghost_calloc(size + MIRROR_FIXTURE_ALIGN - 1, 1);
+    if (*block == ghost_null) {
+        fprintf(stderr, "Failed to allocate fixture arena of %" GHOST_PRIuZ " bytes.\n", size);
+        ghost_abort();
+    }
+    misalign = ghost_static_cast(ghost_size_t,
+            ghost_reinterpret_cast(ghost_uintptr_t, *block) % MIRROR_FIXTURE_ALIGN);
+    return ghost_static_cast(char*, *block) + (misalign == 0 ? 0 : MIRROR_FIXTURE_ALIGN - misalign);
+}
+
+/* Frees everything allocated since the last reset. */
+static void mirror_impl_arena_reset(mirror_impl_arena_t* arena) {
+    void* next;
+    if (arena->overflow == ghost_null) {
+        arena->used = arena->wanted = 0;
+        return;
+    }
+
+    while (arena->overflow != ghost_null) {
+        next = *ghost_static_cast(void**, arena->overflow);
+        ghost_free(arena->overflow);
+        arena->overflow = next;
+    }
+    if (arena->wanted > arena->size) {
+        ghost_free(arena->block);
+        arena->size = arena->wanted;
+        arena->start = mirror_impl_arena_block(&arena->block, arena->size);
+    }
+    arena->used = arena->wanted = 0;
+}
+
+/* Allocates zeroed memory that lives until the next reset. */
+static void* mirror_impl_arena_alloc(mirror_impl_arena_t* arena, ghost_size_t size) {
+    ghost_size_t header = mirror_impl_arena_round(sizeof(void*));
+    void* overflow;
+    char* p;
+
+    size = mirror_impl_arena_round(size);
+    if (arena->block == ghost_null) {
+        arena->size = (size > MIRROR_FIXTURE_ARENA_SIZE) ? size : mirror_impl_arena_round(MIRROR_FIXTURE_ARENA_SIZE);
+        arena->start = mirror_impl_arena_block(&arena->block, arena->size);
+    }
+
+    arena->wanted += size;
+    if (size <= arena->size - arena->used) {
+        p = arena->start + arena->used;
+        arena->used += size;
+    } else {
+        /* The header keeps the allocation aligned. The pointer to the next
+         * block goes at the start of the block itself so it's freed as is. */
+        p = mirror_impl_arena_block(&overflow, header + size) + header;
+        *ghost_static_cast(void**, overflow) = arena->overflow;
+        arena->overflow = overflow;
+    }
+
+    ghost_bzero(p, size);
+    return p;
+}
+
+static void mirror_impl_arena_destroy(mirror_impl_arena_t* arena) {
+    mirror_impl_arena_reset(arena);
+    if (arena->block != ghost_null)
+        ghost_free(arena->block);
+    arena->block = ghost_null;
+    arena->size = 0;
+}
+
+/*
+ * Returns the worker's copy of the shared fixture of the test's suite, setting
+ * it up if no test of the suite has needed it here yet. A check that fails in
+ * the setup fails the test that ran it. Returns null if the setup failed, in
+ * which case every test of the suite on this worker fails.
+ */
+static void* mirror_impl_shared_fixture(mirror_worker_t* worker, mirror_test_t* test) {
+    mirror_suite_t* suite = test->suite;
+    mirror_impl_shared_t* shared;
+
+    if (worker->shared == ghost_null) {
+        worker->shared = ghost_static_cast(mirror_impl_shared_t*,
+                ghost_calloc(mirror_impl_suite_count, sizeof(mirror_impl_shared_t)));
+        if (worker->shared == ghost_null) {
+            fprintf(stderr, "Failed to allocate shared fixtures of %" GHOST_PRIuZ " suites.\n",
+                    mirror_impl_suite_count);
+            ghost_abort();
+        }
+    }
+
+    shared = &worker->shared[suite->index];
+    if (shared->fixture != ghost_null)
+        return shared->fixture;
+    if (shared->failed) {
+        worker->status = mirror_status_fail;
+        mirror_impl_output_lock();
+        printf("Test \"%s\" (%s:%i) failed: the shared fixture of suite \"%s\" failed to set up.\n",
+                test->name, test->file, test->line, suite->name);
+        fflush(stdout);
+        mirror_impl_output_unlock();
+        return ghost_null;
+    }
+
+    shared->fixture = ghost_calloc(suite->fixture_size, 1);
+    if (shared->fixture == ghost_null) {
+        fprintf(stderr, "Failed to allocate shared fixture of size %" GHOST_PRIuZ " for suite %s.\n",
+                suite->fixture_size, suite->name);
+        ghost_abort();
+    }
+    if (!mirror_impl_call(worker, test, mirror_impl_phase_shared_setup, shared->fixture)) {
+        ghost_free(shared->fixture);
+        shared->fixture = ghost_null;
+        shared->failed = ghost_true;
+    }
+    return shared->fixture;
+}
+
+/*
+ * Tears down the shared fixtures set up on a worker. This is called when the
+ * worker has no more tests to run. A check that fails in a teardown here isn't
+ * part of any test so it brings down the process.
+ */
+static void mirror_worker_finish(mirror_worker_t* worker) {
+    mirror_all_suites_t* suites = mirror_all_suites();
+    mirror_suite_t* suite;
+    mirror_impl_shared_t* shared;
+
+    mirror_impl_arena_destroy(&worker->arena);
+    if (worker->shared == ghost_null)
+        return;
+
+    mirror_impl_worker = worker;
+    worker->test = ghost_null;
+    for (suite = mirror_all_suites_first(suites); suite != ghost_null;
+            suite = mirror_all_suites_next(suites, suite))
+    {
+        shared = &worker->shared[suite->index];
+        if (shared->fixture == ghost_null)
+            continue;
+        suite->fixture_teardown(shared->fixture);
+        ghost_free(shared->fixture);
+    }
+
+    ghost_free(worker->shared);
+    worker->shared = ghost_null;
+}
+
+/*
+ * Runs a test (or one instance of a parameterized test) in the current
+ * process. Failures are recorded in the worker's status.
+ */
+static void mirror_run_body(mirror_worker_t* worker, mirror_test_t* test) {
     /*
     printf("%s() %i\n",__func__,__LINE__);
     printf("%p\n",(void*)test);
@@ -165,48 +984,273 @@ static void mirror_run(mirror_test_t* test) {
     /*printf("Running %s\n", test->name); */
     void* fixture = ghost_null;
 
-    if (test->fixture_size != 0) {
-        #if ghost_has_ghost_alloca
-        if (test->fixture_size <= MIRROR_FIXTURE_STACK_THRESHOLD) {
-            fixture = ghost_alloca(test->fixture_size);
-            ghost_bzero(fixture, test->fixture_size);
-        } else
-        #endif
-        {
-            #if ghost_has_ghost_calloc
-                fixture = ghost_calloc(test->fixture_size, 1);
-            #else
-                fprintf(stderr, "Cannot allocate fixture of size %" GHOST_PRIuZ
-                        " for %s without malloc().\n"
-                        "Consider raising MIRROR_FIXTURE_STACK_THRESHOLD.\n",
-                        test->fixture_size, test->name);
-                ghost_abort();
-            #endif
+    mirror_impl_arena_reset(&worker->arena);
+    worker->param = ghost_null;
+    if (test->param_size != 0) {
+        worker->param = mirror_impl_arena_alloc(&worker->arena, test->param_size);
+        if (worker->candidate != ghost_null)
+            memcpy(worker->param, worker->candidate, test->param_size);
+        else
+            test->params.make(&test->params, worker->param, test->param_size, worker->instance);
+    }
+
+    /* A test in a suite shares the suite's fixture. */
+    if (suite != ghost_null && test->fixture_size != 0) {
+        fixture = mirror_impl_shared_fixture(worker, test);
+        if (fixture != ghost_null)
+            mirror_impl_call(worker, test, mirror_impl_phase_test, fixture);
+        return;
+    }
+
+    if (test->fixture_size != 0)
+        fixture = mirror_impl_arena_alloc(&worker->arena, test->fixture_size);
+
+    /* The fixture is torn down even if the test fails, but not if its setup
+     * did. */
+    if (test->fixture_setup == ghost_null ||
+            mirror_impl_call(worker, test, mirror_impl_phase_setup, fixture))
+    {
+        mirror_impl_call(worker, test, mirror_impl_phase_test, fixture);
+        if (test->fixture_teardown != ghost_null)
+            mirror_impl_call(worker, test, mirror_impl_phase_teardown, fixture);
+    }
+}
+
+/*
+ * Runs a death test in a child process, or null if this build can't. Set by
+ * the internal runner.
+ */
+static void (*mirror_impl_death_runner)(mirror_worker_t* worker, mirror_test_t* test);
+
+/* How many instances of a parameterized test a worker claims at a time */
+#ifndef MIRROR_PARAMS_CHUNK
+    #define MIRROR_PARAMS_CHUNK 64
+#endif
+
+/*
+ * Claims the next chunk of instances of a parameterized test. Returns false
+ * if there are none left or one has already failed.
+ */
+static ghost_bool mirror_params_claim(mirror_test_t* test, ghost_uint64_t* first, ghost_uint64_t* end) {
+    ghost_bool claimed;
+    mirror_impl_params_lock();
+    claimed = test->params_next < test->params.count &&
+            (test->status == mirror_status_none || test->status == mirror_status_pass);
+    if (claimed) {
+        *first = test->params_next;
+        *end = (test->params.count - *first > MIRROR_PARAMS_CHUNK) ?
+                *first + MIRROR_PARAMS_CHUNK : test->params.count;
+        test->params_next = *end;
+    }
+    mirror_impl_params_unlock();
+    return claimed;
+}
+
+/*
+ * Called when a worker is done with a schedule entry of a test. Returns true
+ * if the test is finished, which for a parameterized test is when the last
+ * of its entries is done.
+ */
+ghost_maybe_unused
+static ghost_bool mirror_params_finish(mirror_test_t* test) {
+    ghost_bool finished;
+    if (test->param_size == 0)
+        return ghost_true;
+    mirror_impl_params_lock();
+    finished = (--test->params_entries == 0);
+    /* It may have had no instances at all. */
+    if (finished && test->status == mirror_status_none)
+        test->status = mirror_status_pass;
+    mirror_impl_params_unlock();
+    return finished;
+}
+
+/*
+ * Records the results of a run of a test. A parameterized test runs in
+ * pieces, possibly on several workers at once, so its results add up and the
+ * first piece that doesn't pass decides its status.
+ */
+static void mirror_impl_record(mirror_test_t* test, mirror_status_t status,
+        ghost_uint64_t duration, ghost_uint64_t cpu_user, ghost_uint64_t cpu_system)
+{
+    if (test->param_size == 0) {
+        test->status = status;
+        test->duration = duration;
+        test->cpu_user = cpu_user;
+        test->cpu_system = cpu_system;
+        return;
+    }
+
+    mirror_impl_params_lock();
+    if (test->status == mirror_status_none || test->status == mirror_status_pass)
+        test->status = status;
+    test->duration += duration;
+    test->cpu_user += cpu_user;
+    test->cpu_system += cpu_system;
+    mirror_impl_params_unlock();
+}
+
+/*
+ * Shrinks the failing case of a property that's running on the worker, then
+ * runs the test once more with the smallest input that still fails to report
+ * it. Each run gets the test's full timeout.
+ */
+static void mirror_property_shrink(mirror_worker_t* worker, mirror_test_t* test) {
+    const mirror_property_t* property = &test->property;
+    ghost_size_t size = test->param_size;
+    ghost_uint64_t timeout = mirror_impl_timeout(test);
+    ghost_uint64_t attempt = 0, tries = 0, steps = 0;
+    char* smallest;
+    char* candidate;
+    char* swap;
+
+    smallest = ghost_static_cast(char*, ghost_calloc(size, 1));
+    candidate = ghost_static_cast(char*, ghost_calloc(size, 1));
+    if (smallest == ghost_null || candidate == ghost_null) {
+        fprintf(stderr, "Failed to allocate params of %" GHOST_PRIuZ " bytes.\n", size);
+        ghost_abort();
+    }
+    test->params.make(&test->params, smallest, size, worker->instance);
+
+    worker->quiet = ghost_true;
+    while (property->shrink != ghost_null && tries < MIRROR_PROPERTY_SHRINKS &&
+            property->shrink(property, candidate, smallest, size, attempt))
+    {
+        ++tries;
+        if (timeout != 0)
+            mirror_impl_watchdog_arm(worker, mirror_time_now() + timeout);
+        worker->candidate = candidate;
+        worker->status = mirror_status_none;
+        mirror_run_body(worker, test);
+        if (worker->status == mirror_status_none) {
+            ++attempt;
+            continue;
         }
+        swap = smallest;
+        smallest = candidate;
+        candidate = swap;
+        attempt = 0;
+        ++steps;
     }
+    worker->quiet = ghost_false;
 
-    /* TODO */
-    /*int x=5;
-    void* param = &x;*/
+    mirror_impl_output_lock();
+    printf("Test \"%s\" (%s:%i) failed on case %lu of --seed=%lu.\n",
+            test->name, test->file, test->line,
+            ghost_static_cast(unsigned long, worker->instance),
+            ghost_static_cast(unsigned long, mirror_impl_seed));
+    if (property->print != ghost_null) {
+        if (steps != 0)
+            printf("    Shrunk it %lu times to: ", ghost_static_cast(unsigned long, steps));
+        else
+            printf("    Its input was: ");
+        property->print(property, smallest, size);
+        printf("\n");
+    } else if (steps != 0) {
+        printf("    Shrunk it %lu times.\n", ghost_static_cast(unsigned long, steps));
+    }
+    fflush(stdout);
+    mirror_impl_output_unlock();
 
-    if (test && test->fixture_setup)
-        test->fixture_setup(fixture);
-    test->fn(fixture, ghost_null/*TODO param*/);
-    if (test && test->fixture_teardown)
-        test->fixture_teardown(fixture);
+    if (timeout != 0)
+        mirror_impl_watchdog_arm(worker, mirror_time_now() + timeout);
+    worker->candidate = smallest;
+    worker->status = mirror_status_none;
+    mirror_run_body(worker, test);
+    worker->candidate = ghost_null;
+    if (worker->status == mirror_status_none) {
+        worker->status = mirror_status_fail;
+        mirror_impl_output_lock();
+        printf("Test \"%s\" (%s:%i) passed when run again with its shrunk param. It may be flaky.\n",
+                test->name, test->file, test->line);
+        fflush(stdout);
+        mirror_impl_output_unlock();
+    }
 
-    if (suite && suite->fixture_size != 0) {
-        #if ghost_has(ghost_alloca)
-        if (suite->fixture_size <= MIRROR_FIXTURE_STACK_THRESHOLD) {
-            /* nothing */
-        } else
-        #endif
-        {
-            #if ghost_has(ghost_free)
-            ghost_free(fixture);
-            #endif
+    ghost_free(candidate);
+    ghost_free(smallest);
+}
+
+/*
+ * Runs the given instances of a parameterized test, stopping at the first
+ * that doesn't pass. Each instance gets the test's full timeout. The cases of
+ * a property run quietly so that only a shrunk failure is reported.
+ */
+static void mirror_run_instances(mirror_worker_t* worker, mirror_test_t* test,
+        ghost_uint64_t first, ghost_uint64_t end)
+{
+    ghost_uint64_t timeout = mirror_impl_timeout(test);
+    ghost_bool property = (test->property.generate != ghost_null);
+    for (worker->instance = first; worker->instance < end; ++worker->instance) {
+        if (timeout != 0)
+            mirror_impl_watchdog_arm(worker, mirror_time_now() + timeout);
+        worker->quiet = property;
+        mirror_run_body(worker, test);
+        worker->quiet = ghost_false;
+        if (worker->status != mirror_status_none) {
+            if (property)
+                mirror_property_shrink(worker, test);
+            break;
+        }
+    }
+    if (timeout != 0)
+        mirror_impl_watchdog_arm(worker, 0);
+}
+
+/*
+ * Runs a test on the given worker, recording its status and timing. A
+ * parameterized test runs the instances given to a worker process, or
+ * otherwise as many as the worker can claim.
+ */
+static void mirror_run(mirror_worker_t* worker, mirror_test_t* test) {
+    ghost_uint64_t start, timeout, duration, first, end, user = 0, system = 0;
+
+    if (mirror_impl_time_cpu)
+        mirror_time_cpu(&user, &system);
+    start = mirror_time_now();
+
+    mirror_impl_worker = worker;
+    worker->test = test;
+    worker->status = mirror_status_none;
+
+    if (test->param_size != 0) {
+        if (worker->params_first < worker->params_end)
+            mirror_run_instances(worker, test, worker->params_first, worker->params_end);
+        else
+            while (worker->status == mirror_status_none && mirror_params_claim(test, &first, &end))
+                mirror_run_instances(worker, test, first, end);
+    } else {
+        /* Death tests time themselves out. */
+        timeout = test->death ? 0 : mirror_impl_timeout(test);
+        if (timeout != 0)
+            mirror_impl_watchdog_arm(worker, start + timeout);
+
+        if (!test->death) {
+            mirror_run_body(worker, test);
+        } else if (mirror_impl_death_runner != ghost_null) {
+            mirror_impl_death_runner(worker, test);
+            worker->status = test->status;
+        } else {
+            worker->status = mirror_status_fail;
+            printf("Test \"%s\" (%s:%i) is a death test but this build of mirror can't fork.\n",
+                    test->name, test->file, test->line);
         }
+
+        if (timeout != 0)
+            mirror_impl_watchdog_arm(worker, 0);
+    }
+
+    duration = mirror_time_now() - start;
+    worker->cpu_user = worker->cpu_system = 0;
+    if (mirror_impl_time_cpu) {
+        mirror_time_cpu(&worker->cpu_user, &worker->cpu_system);
+        worker->cpu_user -= user;
+        worker->cpu_system -= system;
     }
+    if (worker->status == mirror_status_none)
+        worker->status = mirror_status_pass;
+    mirror_impl_record(test, worker->status, duration, worker->cpu_user, worker->cpu_system);
+    worker->test = ghost_null;
 }
 
 #ifdef __cplusplus
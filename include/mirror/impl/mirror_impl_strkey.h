@@ -0,0 +1,81 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIRROR_IMPL_STRKEY_H
+#define MIRROR_IMPL_STRKEY_H
+
+/*
+ * A string key for tmmap with a cached prefix.
+ *
+ * The first eight bytes of the string are packed big-endian into an integer
+ * stored alongside the string pointer. Comparing two prefixes orders them the
+ * same way strcmp() would, so a tree descent can usually decide which way to
+ * go without touching the string itself (which is likely somewhere else in
+ * memory and not in cache.) The strings are only compared on a prefix tie,
+ * and then only past the prefix.
+ *
+ * To use it, store a mirror_strkey_t next to the tree node in the value, use
+ * const mirror_strkey_t* as the key type, and pass mirror_strkey_compare as
+ * the compare function of the map.
+ */
+
+#include "mirror/impl/mirror_impl_ghost.h"
+
+/*TODO*/
+#include <string.h>
+
+typedef struct mirror_strkey_t {
+    ghost_uint64_t prefix; /* first eight bytes, big-endian, zero padded */
+    const char* string;
+} mirror_strkey_t;
+
+/* Initializes a key for the given string. The string is not copied. */
+ghost_maybe_unused
+static void mirror_strkey_init(mirror_strkey_t* key, const char* string) {
+    ghost_uint64_t prefix = 0;
+    int i;
+    for (i = 0; i < 8; ++i) {
+        prefix <<= 8;
+        if (string[i] == '\0') {
+            prefix <<= 8 * (7 - i);
+            break;
+        }
+        prefix |= ghost_static_cast(unsigned char, string[i]);
+    }
+    key->prefix = prefix;
+    key->string = string;
+}
+
+ghost_maybe_unused
+static int mirror_strkey_compare(const mirror_strkey_t* left, const mirror_strkey_t* right) {
+    if (left->prefix != right->prefix)
+        return (left->prefix < right->prefix) ? -1 : 1;
+
+    /* A zero low byte means the strings ended within the prefix. */
+    if ((left->prefix & 0xffu) == 0)
+        return 0;
+    return strcmp(left->string + 8, right->string + 8);
+}
+
+#endif
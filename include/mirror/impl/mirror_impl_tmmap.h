@@ -86,6 +86,57 @@ value_t* mirror_tmmap_any(mirror_tmmap_t* map);
         #define MIRROR_TMMAP_DEFINE_ANY(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
             /*nothing*/
 
+#if MIRROR_IMPL_TMMAP_DOCUMENTATION
+/**
+ * @def MIRROR_TMMAP_DECLARE_BUILD_SORTED(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, inline_attrib, noninline_attrib)
+ *
+ * Declares a function that replaces the contents of the map with a sorted
+ * array of values.
+ */
+
+/**
+ * @def MIRROR_TMMAP_DEFINE_BUILD_SORTED(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, inline_attrib, noninline_attrib)
+ *
+ * Defines a function that replaces the contents of the map with a sorted
+ * array of values.
+ */
+
+/**
+ * Replaces the contents of the map with the given values in linear time.
+ *
+ * The values must already be sorted by key. Values with equal keys keep the
+ * order given. No keys are compared. Any values previously in the map are
+ * discarded without being touched.
+ *
+ * This is a template function that must be instantiated. The prefix
+ * "mirror_tmmap" is replaced by the prefix of the template.
+ */
+void mirror_tmmap_build_sorted(mirror_tmmap_t* map, value_t* const* values, size_t count);
+#endif
+
+        #define MIRROR_TMMAP_DECLARE_BUILD_SORTED(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
+            GHOST_IMPL_FUNCTION_OPEN \
+            noninline_attrib \
+            void prefix##_build_sorted(prefix##_t* map, value_t* const* values, ghost_size_t count); \
+            GHOST_IMPL_FUNCTION_CLOSE
+
+        #define MIRROR_TMMAP_DEFINE_BUILD_SORTED(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
+            GHOST_IMPL_FUNCTION_OPEN \
+            \
+            ghost_maybe_unused \
+            static mirror_iwbt_node_t* prefix##_build_sorted_node_at(const void* context, ghost_size_t index) { \
+                return &ghost_static_cast(value_t* const*, context)[index]->node_field; \
+            } \
+            \
+            noninline_attrib \
+            void prefix##_build_sorted(prefix##_t* map, value_t* const* values, ghost_size_t count) { \
+                ghost_assert(map != ghost_null, ""); \
+                ghost_assert(count == 0 || values != ghost_null, ""); \
+                mirror_impl_iwbt_build_from(&map->tree, prefix##_build_sorted_node_at, values, count); \
+            } \
+            \
+            GHOST_IMPL_FUNCTION_CLOSE
+
 #if MIRROR_IMPL_TMMAP_DOCUMENTATION
 /**
  * @def MIRROR_TMMAP_DECLARE_CLEAR(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, inline_attrib, noninline_attrib)
@@ -480,6 +531,7 @@ value_t* mirror_tmmap_first(mirror_tmmap_t* map);
 #endif
 #define GHOST_IMPL_TMMAP_DECLARE_FUNCTIONS(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
     MIRROR_TMMAP_DECLARE_ANY                 (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
+    MIRROR_TMMAP_DECLARE_BUILD_SORTED        (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
     MIRROR_TMMAP_DECLARE_CLEAR               (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
     MIRROR_TMMAP_DECLARE_COUNT               (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
     MIRROR_TMMAP_DECLARE_FIND_AFTER          (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib, inline_attrib) \
@@ -510,6 +562,7 @@ value_t* mirror_tmmap_first(mirror_tmmap_t* map);
 #endif
 #define GHOST_IMPL_TMMAP_DEFINE_FUNCTIONS(prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
     MIRROR_TMMAP_DEFINE_ANY                 (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
+    MIRROR_TMMAP_DEFINE_BUILD_SORTED        (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
     MIRROR_TMMAP_DEFINE_CLEAR               (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
     MIRROR_TMMAP_DEFINE_COUNT               (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
     MIRROR_TMMAP_DEFINE_FIND_AFTER          (prefix, key_t, value_t, node_field, value_key_fn, compare_fn, noninline_attrib) \
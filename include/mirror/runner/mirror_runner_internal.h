@@ -34,6 +34,20 @@
 #include "ghost/header/c/ghost_stdlib_h.h"
 
 #include "mirror/impl/mirror_impl_runner_common.h"
+#include "mirror/impl/mirror_impl_internal_options.h"
+#include "mirror/impl/mirror_impl_internal_corpus.h"
+#include "mirror/impl/mirror_impl_internal_pool.h"
+#include "mirror/impl/mirror_impl_internal_death.h"
+#include "mirror/impl/mirror_impl_internal_fork.h"
+#include "mirror/impl/mirror_impl_internal_filter.h"
+#include "mirror/impl/mirror_impl_internal_history.h"
+#include "mirror/impl/mirror_impl_internal_list.h"
+#include "mirror/impl/mirror_impl_internal_plan.h"
+#include "mirror/impl/mirror_impl_internal_registry.h"
+#include "mirror/impl/mirror_impl_internal_report.h"
+#include "mirror/impl/mirror_impl_internal_sched.h"
+#include "mirror/impl/mirror_impl_internal_shard.h"
+#include "mirror/impl/mirror_impl_internal_watchdog.h"
 
 #if 0
 static void mirror_suite_run(mirror_suite_t* suite) {
@@ -53,10 +67,38 @@ static void mirror_suite_run(mirror_suite_t* suite) {
 }
 #endif
 
-int main(void) {
-    mirror_test_t* test;
+int main(int argc, char** argv) {
+    mirror_options_t options;
+    mirror_worker_t worker = GHOST_ZERO_INIT;
+    mirror_test_t** tests;
+    mirror_history_t history;
+    mirror_plan_t plan;
+    #if MIRROR_THREADS || MIRROR_FORK
+    mirror_sched_t sched;
+    ghost_size_t jobs;
+    #endif
+    char* history_path = ghost_null;
+    ghost_size_t count;
+    ghost_size_t failed;
+    ghost_size_t blocked;
+    ghost_size_t unrun;
+    ghost_size_t i;
+    ghost_bool timeouts;
 
+    mirror_options_parse(&options, argc, argv);
     mirror_init();
+    mirror_registry_init();
+
+    /* Listing runs nothing and needs nothing but the filter. */
+    if (options.list != mirror_list_format_none) {
+        ghost_bool listed;
+        tests = mirror_filter_select(&options, &count);
+        listed = mirror_list_tests(tests, count, options.list);
+        ghost_free(tests);
+        mirror_registry_destroy();
+        mirror_teardown();
+        return listed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
 (void)&mirror_run;
     #if 0
@@ -73,16 +115,140 @@ int main(void) {
     }
     #endif
 
-    for (test = mirror_all_tests_first(mirror_all_tests());
-            test;
-            test = mirror_all_tests_next(mirror_all_tests(), test))
+    /* Load how each test did last time so we can schedule failing,
+     * changed and slow ones first. */
+    mirror_history_init(&history);
+    if (!options.no_history) {
+        history_path = mirror_history_path(options.history, (argc > 0) ? argv[0] : "mirror");
+        if (history_path != ghost_null)
+            mirror_history_load(&history, history_path);
+    }
+
+    /* Collect the tests that pass the filter and belong to this shard in
+     * registry order so workers can share them out. */
+    if (options.shard_count > 1)
+        mirror_shard_touch_status_file();
+    tests = mirror_filter_select(&options, &count);
+    count = mirror_shard_select(&options, &history, tests, count);
+    mirror_history_apply(&history, tests, count);
+    mirror_plan_init(&plan, &options, tests, &count);
+
+    /* Per-process CPU time is only per test if the process runs one test
+     * at a time. */
+    mirror_impl_time_cpu = MIRROR_CPU_TIME && options.slowest != 0 &&
+            (MIRROR_IMPL_CPU_TIME_PER_THREAD || options.fork || options.jobs == 1);
+
+    #if MIRROR_THREADS || MIRROR_FORK
+    /* A parameterized test can keep every worker busy. */
+    jobs = 0;
+    for (i = 0; i < count && jobs < options.jobs; ++i)
+        jobs += (tests[i]->param_size != 0) ? options.jobs : 1;
+    if (jobs > options.jobs)
+        jobs = options.jobs;
+    #endif
+
+    /* Workers are forked after this so they share the seed and the
+     * corpora. */
+    mirror_corpus_load(tests, count);
+    mirror_impl_seed = options.seeded ? options.seed :
+            ghost_static_cast(ghost_size_t, mirror_time_now());
+
+    /* Death tests are forked. Worker processes fork them directly but
+     * in-process workers need fork servers, started before any threads. */
+    #if MIRROR_FORK
+    if (options.fork)
+        mirror_impl_death_runner = mirror_death_run_forked;
+    else if (mirror_death_any(tests, count))
+        mirror_death_start((MIRROR_THREADS && jobs > 1) ? jobs : 1);
+    #endif
+
+    /* In-process tests need the watchdog thread to enforce timeouts. */
+    mirror_impl_default_timeout = options.timeout;
+    mirror_impl_fail_fast = options.fail_fast;
+    timeouts = (options.timeout != 0);
+    for (i = 0; i < count && !timeouts; ++i)
+        timeouts = (tests[i]->timeout != 0);
+    if (timeouts && !options.fork) {
+        #if MIRROR_THREADS
+        mirror_watchdog_start();
+        #else
+        fprintf(stderr, "Warning: this build of mirror cannot enforce timeouts without --fork.\n");
+        #endif
+    }
+
+    #if MIRROR_FORK
+    if (options.fork && jobs > 0) {
+        mirror_sched_init(&sched, tests, count, jobs);
+        mirror_fork_run(&sched);
+        mirror_sched_destroy(&sched);
+    } else
+    #endif
+    #if MIRROR_THREADS
+    if (jobs > 1) {
+        mirror_sched_init(&sched, tests, count, jobs);
+        mirror_pool_run(&sched);
+        mirror_sched_destroy(&sched);
+    } else
+    #endif
     {
-        mirror_run(test);
+        ghost_size_t pruned = 0;
+        #if MIRROR_THREADS
+        mirror_watchdog_watch(&worker);
+        #endif
+        /* The plan is in dependency order. Tests that are blocked by a
+         * failed dependency by the time we get to them are skipped. */
+        for (i = 0; i < count; ++i) {
+            if (tests[i]->status != mirror_status_none)
+                continue;
+            mirror_run(&worker, tests[i]);
+            mirror_plan_done(tests[i], ghost_null, &pruned);
+        }
+        mirror_worker_finish(&worker);
+    }
+    #if MIRROR_THREADS
+    mirror_watchdog_stop();
+    #endif
+    #if MIRROR_FORK
+    mirror_death_stop();
+    #endif
+
+    mirror_corpus_unload();
+
+    if (history_path != ghost_null) {
+        mirror_history_save(history_path, tests, count);
+        ghost_free(history_path);
     }
+    mirror_history_destroy(&history);
 
+    if (options.slowest != 0)
+        mirror_report_slowest(tests, count, options.slowest);
+
+    failed = mirror_report_failures(tests, count);
+    blocked = unrun = 0;
+    for (i = 0; i < count; ++i) {
+        if (tests[i]->status == mirror_status_blocked)
+            ++blocked;
+        else if (tests[i]->status == mirror_status_none)
+            ++unrun;
+    }
+
+    mirror_plan_destroy(&plan);
+    ghost_free(tests);
+    mirror_registry_destroy();
     mirror_teardown();
 
-    printf("All %" GHOST_PRIdZ " tests pass.\n", mirror_all_tests_count(mirror_all_tests()));
+    if (plan.skipped != 0)
+        printf("%" GHOST_PRIuZ " tests were skipped.\n", plan.skipped);
+    if (blocked != 0)
+        printf("%" GHOST_PRIuZ " tests were blocked by a failed dependency.\n", blocked);
+    if (unrun != 0)
+        printf("%" GHOST_PRIuZ " tests were not run.\n", unrun);
+    if (failed != 0 || blocked != 0 || unrun != 0) {
+        printf("%" GHOST_PRIuZ " of %" GHOST_PRIuZ " tests failed.\n", failed, count);
+        return EXIT_FAILURE;
+    }
+
+    printf("All %" GHOST_PRIuZ " tests pass.\n", count);
 
         #ifdef __PCC__
         _Exit(EXIT_SUCCESS);
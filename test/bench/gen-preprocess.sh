@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Generates a synthetic test file for the preprocessing benchmark.
+#
+# Usage: gen-preprocess.sh COUNT FILE
+#
+# Writes COUNT tests to FILE cycling through a mix of options: none, a name,
+# a description, deps, timeouts, skip/smoke/death, prefixed options, custom
+# ids and fixtures with setup and teardown.
+
+set -e
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 COUNT FILE" >&2
+    exit 1
+fi
+
+awk -v count="$1" 'BEGIN {
+    print "/* Generated by gen-preprocess.sh. Do not edit. */"
+    print "#define MIRROR_ID bench_pp"
+    print "#include \"mirror/mirror.h\""
+    print ""
+    print "static int bench_setup(void) { return 1; }"
+    print "static void bench_teardown(int value) { (void)value; }"
+    for (i = 0; i < count; ++i) {
+        print ""
+        kind = i % 8
+        if (kind == 0)
+            print "mirror() {"
+        else if (kind == 1)
+            printf "mirror(name(\"bench/%d\")) {\n", i
+        else if (kind == 2)
+            printf "mirror(name(\"bench/%d\"), it(\"should work\"), smoke) {\n", i
+        else if (kind == 3)
+            printf "mirror(name(\"bench/%d\"), deps(\"bench/%d\", \"bench/%d\"), timeout(1000)) {\n", i, i - 1, i - 2
+        else if (kind == 4)
+            printf "mirror(mirror_name(\"bench/%d\"), mirror_skip, mirror_it(\"is skipped\")) {\n", i
+        else if (kind == 5)
+            printf "mirror(id(bench_%d), name(\"bench/%d\")) {\n", i, i
+        else if (kind == 6)
+            printf "mirror(name(\"bench/%d\"), fixture(int, value), setup(bench_setup), teardown(bench_teardown)) {\n    mirror_check(value == 1);\n", i
+        else
+            printf "mirror(name(\"bench/%d\"), death, it(\"dies\"), timeout(10), smoke, deps(\"bench/%d\"), skip, nothing) {\n", i, i - 1
+        print "    mirror_check(1);"
+        print "}"
+    }
+}' > "$2"
@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Generates a synthetic test program for the startup benchmark.
+#
+# Usage: gen-startup.sh COUNT DIRECTORY
+#
+# Writes COUNT trivial tests to DIRECTORY split into translation units of up
+# to 1000 tests each (tests_0.c, tests_1.c...) along with a main.c that
+# includes the internal runner. Each translation unit has its own MIRROR_ID so
+# the program can also be built with a generated registry. Names are
+# shuffled between files so the runner can't rely on them arriving sorted.
+
+set -e
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 COUNT DIRECTORY" >&2
+    exit 1
+fi
+
+count=$1
+dir=$2
+per_file=1000
+
+mkdir -p "$dir"
+rm -f "$dir"/tests_*.c
+
+cat > "$dir/main.c" <<END
+/* Generated by gen-startup.sh. Do not edit. */
+#define MIRROR_ID bench_main
+#include "mirror/mirror.h"
+#include "mirror/runner/mirror_runner_internal.h"
+END
+
+awk -v count="$count" -v per_file="$per_file" -v dir="$dir" 'BEGIN {
+    files = int((count + per_file - 1) / per_file)
+    for (i = 0; i < count; ++i) {
+        file = i % files
+        path = dir "/tests_" file ".c"
+        if (!(file in started)) {
+            started[file] = 1
+            print "/* Generated by gen-startup.sh. Do not edit. */" > path
+            print "#define MIRROR_ID bench_" file > path
+            print "#include \"mirror/mirror.h\"" > path
+        }
+        printf "\nmirror(name(\"bench/group%03d/test%06d\")) {\n    mirror_check(%d != 0);\n}\n", \
+                i % 997, i, i + 1 > path
+    }
+}'
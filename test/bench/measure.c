@@ -0,0 +1,131 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Runs a command and prints its wall time in seconds and the peak resident
+ * memory in KiB of it and its descendants, e.g. "1.234567 56789".
+ *
+ * Usage: measure [-n RUNS] COMMAND [ARG...]
+ *
+ * With -n the command is run that many times and the fastest run is
+ * reported. The command's standard output is discarded so only our result is
+ * printed. The exit status is that of the command (or 1 if it didn't exit
+ * normally.)
+ *
+ * This is a stand-in for GNU time, which isn't available everywhere.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static double measure_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Runs the command once. Returns its exit status. */
+static int measure_run(char** argv, double* out_seconds, long* out_kib) {
+    struct rusage usage;
+    double start;
+    int status;
+    pid_t pid;
+    int null;
+
+    fflush(stdout);
+    start = measure_now();
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+            dup2(null, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        exit(EXIT_FAILURE);
+    }
+    *out_seconds = measure_now() - start;
+
+    /* Linux reports KiB; macOS reports bytes. */
+    #ifdef __APPLE__
+    *out_kib = usage.ru_maxrss / 1024;
+    #else
+    *out_kib = usage.ru_maxrss;
+    #endif
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+int main(int argc, char** argv) {
+    double best = 0, seconds;
+    long peak = 0, kib;
+    int runs = 1;
+    int status = 0;
+    int i;
+
+    ++argv;
+    --argc;
+    if (argc >= 2 && 0 == strcmp(argv[0], "-n")) {
+        runs = atoi(argv[1]);
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc < 1 || runs < 1) {
+        fprintf(stderr, "Usage: measure [-n RUNS] COMMAND [ARG...]\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < runs; ++i) {
+        status = measure_run(argv, &seconds, &kib);
+        if (status != 0)
+            break;
+        if (i == 0 || seconds < best)
+            best = seconds;
+        if (kib > peak)
+            peak = kib;
+    }
+
+    printf("%.6f %ld\n", best, peak);
+    return status;
+}
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Benchmarks preprocessing of mirror() with and without the fast path.
+#
+# Usage: preprocess.sh BUILD_DIRECTORY COUNT
+#
+# Generates a file of COUNT tests with a mix of options (see
+# gen-preprocess.sh) and preprocesses it with MIRROR_IMPL_FAST_PP set to 0
+# (the portable path) and 1 (the fast path), reporting the fastest of RUNS
+# runs (default 5) as milliseconds per 1000 tests along with the compiler's
+# peak memory. Both are compiled, and the preprocessed outputs are compared
+# ignoring whitespace to check that both paths generate the same code.
+#
+# Set CC and CFLAGS to choose the compiler. This must be run from the root of
+# the repository after building the measure tool into BUILD_DIRECTORY.
+
+set -e
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 BUILD_DIRECTORY COUNT" >&2
+    exit 1
+fi
+
+build=$1
+count=$2
+measure="$build/measure"
+cc=${CC:-cc}
+flags="$CFLAGS -Iinclude -Itest/ghost/include"
+dir="$build/preprocess"
+
+mkdir -p "$dir"
+sh test/bench/gen-preprocess.sh "$count" "$dir/tests.c"
+
+printf '%6s %16s %11s\n' path ms-per-1000 kib
+for fast in 0 1; do
+    # shellcheck disable=SC2086
+    result=$("$measure" -n "${RUNS:-5}" $cc $flags -DMIRROR_IMPL_FAST_PP=$fast -E -P \
+            -o "$dir/tests-$fast.i" "$dir/tests.c")
+    # shellcheck disable=SC2086
+    $cc $flags -DMIRROR_IMPL_FAST_PP=$fast -c -o "$dir/tests-$fast.o" "$dir/tests.c"
+    tr -d ' \t\n' < "$dir/tests-$fast.i" > "$dir/tests-$fast.tokens"
+    echo "$fast $count $result" | awk '{
+        printf "%6s %16.1f %11d\n", ($1 == 1) ? "fast" : "ansi", $3 * 1000 * 1000 / $2, $4 }'
+done
+
+if cmp -s "$dir/tests-0.tokens" "$dir/tests-1.tokens"; then
+    echo "Both paths generate the same code."
+else
+    echo "The fast path generates different code!" >&2
+    exit 1
+fi
@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# Benchmarks registration and startup as the number of tests grows.
+#
+# Usage: startup.sh BUILD_DIRECTORY COUNT...
+#
+# For each count this generates a synthetic program with that many tests,
+# compiles it one translation unit at a time and links it, then runs it with a
+# filter that excludes every test. That run does nothing but start up: the
+# registration blocks (static constructors, unless the tests are registered
+# through a linker section or a generated registry), mirror_init() and the
+# registry. A program with no tests is measured first as the baseline.
+#
+# It prints a table of:
+#
+#     tests       the number of tests
+#     compile     total compile time in seconds
+#     compile-kib peak memory of the compiler in KiB
+#     link        link time in seconds
+#     size        size of the program in bytes
+#     startup     startup time in milliseconds (the fastest of RUNS runs)
+#     startup-kib peak memory at startup in KiB
+#
+# Set CC and CFLAGS to choose the compiler, RUNS to change the number of
+# startup runs (default 5) and GENERATED_REGISTRY=1 to build with a generated
+# registry. This must be run from the root of the repository after building
+# the measure tool into BUILD_DIRECTORY.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "Usage: $0 BUILD_DIRECTORY COUNT..." >&2
+    exit 1
+fi
+
+build=$1
+shift
+measure="$build/measure"
+cc=${CC:-cc}
+flags="${CFLAGS:--O2} -pthread -Iinclude -Itest/ghost/include"
+if [ "$GENERATED_REGISTRY" = 1 ]; then
+    flags="$flags -DMIRROR_GENERATED_REGISTRY=1"
+fi
+
+printf '%8s %9s %11s %7s %10s %9s %11s\n' \
+    tests compile compile-kib link size startup startup-kib
+
+for count in 0 "$@"; do
+    dir="$build/$count"
+    sh test/bench/gen-startup.sh "$count" "$dir"
+
+    # Compile everything in one shell so that we get the total. This is
+    # slow: the compiler spends most of its time expanding mirror().
+    set -- "$dir/main.c" "$dir"/tests_*.c
+    [ -e "$2" ] || set -- "$1"
+    script='cc=$1; flags=$2; shift 2; for src; do $cc $flags -c -o "${src%.c}.o" "$src" || exit 1; done'
+    compile=$("$measure" sh -c "$script" sh "$cc" "$flags" "$@")
+
+    objects=$(for src; do echo "${src%.c}.o"; done)
+    if [ "$GENERATED_REGISTRY" = 1 ]; then
+        # shellcheck disable=SC2086
+        sh tools/mirror-registry "$dir/registry.c" $objects
+        $cc $flags -c -o "$dir/registry.o" "$dir/registry.c"
+        objects="$objects $dir/registry.o"
+    fi
+    # shellcheck disable=SC2086
+    link=$("$measure" $cc $flags -o "$dir/runner" $objects)
+    size=$(wc -c < "$dir/runner")
+
+    startup=$("$measure" -n "${RUNS:-5}" "$dir/runner" --no-history --filter='-*')
+
+    echo "$count $compile $link $size $startup" | awk '{
+        printf "%8d %9.2f %11d %7.3f %10d %9.3f %11d\n", $1, $2, $3, $4, $6, $7 * 1000, $8 }'
+done
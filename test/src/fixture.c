@@ -67,14 +67,22 @@ static void buffer_teardown(FILE* file) {
     fclose(file);
 }
 
-/* TODO this should be a suite but suites aren't implemented yet */
+/* the file is opened once per worker and shared by the tests of the suite */
 
-mirror(name("file/zero/getc"), fixture(FILE*, file), setup(buffer_setup), teardown(buffer_teardown)) {
+mirror_suite("file/zero", FILE*, buffer_setup, buffer_teardown);
+
+mirror(name("file/zero/getc"), suite("file/zero"), fixture(FILE*, file)) {
     mirror_check(getc(file) == 0);
 }
 
-mirror(name("file/zero/fread"), fixture(FILE*, file), setup(buffer_setup), teardown(buffer_teardown)) {
+mirror(name("file/zero/fread"), suite("file/zero"), fixture(FILE*, file)) {
     char b[1];
     mirror_check(fread(b, 1, 1, file) == 1);
     mirror_check(b[0] == 0);
 }
+
+/* tests in a suite don't need to take its fixture */
+
+mirror(name("file/zero/none"), suite("file/zero")) {
+    mirror_check(1);
+}
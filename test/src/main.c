@@ -25,6 +25,8 @@
 #define MIRROR_ID mirror_self_unit_tests
 #include "mirror/mirror.h"
 
+#include <stdlib.h>
+
 mirror_0() {
     mirror_check(1);
 }
@@ -36,6 +38,34 @@ mirror(id(custom_id), it("should work")) {
     mirror_check(true);
 }
 
+mirror(it("should finish within its timeout"), timeout(10000)) {
+    mirror_check(true);
+}
+
+mirror(name("deps/first"), smoke) {
+    mirror_check(true);
+}
+
+mirror(name("deps/second"), deps("deps/first")) {
+    mirror_check(true);
+}
+
+mirror(name("skipped"), skip) {
+    mirror_fail();
+}
+
+mirror(name("death/abort"), death) {
+    abort();
+}
+
+/* A failed check in a death test fails it, even with --fail-fast. This only
+ * fails when test/Makefile asks it to. */
+mirror(name("death/check"), death) {
+    if (getenv("MIRROR_TEST_EXPECT_FAILURE") == NULL)
+        abort();
+    mirror_check(0);
+}
+
 #ifdef GOOGLETEST
 #include "mirror/runner/mirror_runner_googletest.hxx"
 #elif defined(CRITERION)
@@ -0,0 +1,178 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2022-2023 Fraser Heavy Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define MIRROR_ID params
+#include "mirror/mirror.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+
+/* parameterized tests
+ *
+ * each instance is a test of its own, run with the next parameter */
+
+
+
+static const int primes[] = {2, 3, 5, 7, 11, 13};
+
+mirror(name("params/primes"), param(int, p), params(mirror_params_array(primes))) {
+    int i;
+    for (i = 2; i * i <= p; ++i)
+        mirror_check(p % i != 0);
+}
+
+
+
+/* a range big enough to be shared out to several workers */
+
+mirror(name("params/range"), param(long, n), params(mirror_params_range(-500, 1500))) {
+    mirror_check(n >= -500 && n < 1500);
+    mirror_eq(n * n % 4 == 0, n % 2 == 0);
+}
+
+
+
+/* the squares of 0 to 99, made as they're needed */
+
+static void square(void* param, ghost_uint64_t index, void* context) {
+    *ghost_static_cast(ghost_uint64_t*, param) = index * index + *ghost_static_cast(ghost_uint64_t*, context);
+}
+
+static ghost_uint64_t zero = 0;
+
+mirror(name("params/squares"), param(ghost_uint64_t, s),
+        params(mirror_params_generate(100, square, &zero)))
+{
+    ghost_uint64_t root = 0;
+    while (root * root < s)
+        ++root;
+    mirror_check(root * root == s);
+}
+
+
+
+/* each instance gets a fresh fixture */
+
+static int counter_setup(void) {
+    return 0;
+}
+
+mirror(name("params/fixture"), fixture(int, counter), setup(counter_setup),
+        param(short, n), params(mirror_params_range(1, 200)))
+{
+    mirror_eq(counter, 0);
+    counter += n;
+    mirror_eq(counter, n);
+}
+
+
+
+/* property tests
+ *
+ * random inputs from a seed, with failures shrunk to the smallest input that
+ * still fails */
+
+
+
+mirror(name("params/property/abs"), param(int, x),
+        property(mirror_property_integers(10000, -1000000, 1000000)))
+{
+    int y = (x < 0) ? -x : x;
+    mirror_check(y >= 0 && (y == x || y == -x));
+}
+
+
+
+/* fails from 1000 up so that test/Makefile can check it's shrunk to exactly
+ * 1000, but only when it asks */
+
+mirror(name("params/property/shrink"), param(int, x),
+        property(mirror_property_integers(1000, -1000000, 1000000)))
+{
+    if (getenv("MIRROR_TEST_EXPECT_FAILURE") != NULL)
+        mirror_check(x < 1000);
+}
+
+
+
+/* pairs of bytes, generated and shrunk by hand */
+
+typedef struct pair_t {
+    unsigned char a;
+    unsigned char b;
+} pair_t;
+
+static void pair_generate(const mirror_property_t* property, void* param,
+        ghost_size_t param_size, mirror_random_t* random)
+{
+    pair_t* pair = ghost_static_cast(pair_t*, param);
+    (void)property;
+    (void)param_size;
+    pair->a = ghost_static_cast(unsigned char, mirror_random_below(random, 256));
+    pair->b = ghost_static_cast(unsigned char, mirror_random_below(random, 256));
+}
+
+static ghost_bool pair_shrink(const mirror_property_t* property, void* candidate,
+        const void* param, ghost_size_t param_size, ghost_uint64_t attempt)
+{
+    const pair_t* pair = ghost_static_cast(const pair_t*, param);
+    pair_t* smaller = ghost_static_cast(pair_t*, candidate);
+    (void)property;
+    (void)param_size;
+    *smaller = *pair;
+    if (attempt == 0 && pair->a != 0)
+        smaller->a = ghost_static_cast(unsigned char, pair->a / 2);
+    else if (attempt <= 1 && pair->b != 0)
+        smaller->b = ghost_static_cast(unsigned char, pair->b / 2);
+    else
+        return ghost_false;
+    return ghost_true;
+}
+
+mirror(name("params/property/pair"), param(pair_t, pair),
+        property(mirror_property_generate(1000, pair_generate, pair_shrink, ghost_null, ghost_null)))
+{
+    mirror_check(pair.a + pair.b <= 510);
+}
+
+
+
+/* corpora
+ *
+ * each file is a record, mapped rather than read */
+
+
+
+mirror(name("params/corpus/dir"), param(mirror_record_t, record), corpus("test/corpus")) {
+    const char* data = ghost_static_cast(const char*, record.data);
+    mirror_check(0 == strncmp(record.name, "test/corpus/", 12));
+    mirror_check(record.size == 0 || data[record.size - 1] == '\n');
+}
+
+mirror(name("params/corpus/file"), param(mirror_record_t, golden), corpus("test/corpus/hello.txt")) {
+    mirror_eq(golden.size, 6);
+    mirror_check(0 == memcmp(golden.data, "hello\n", 6));
+}